@@ -11,7 +11,64 @@ if errorlevel 1 exit /b 1
 g++ -c src/camera.cpp -I./include
 if errorlevel 1 exit /b 1
 
-g++ main.o graphics.o texture.o camera.o -o main.exe -L./lib -lmingw32 -lSDL2main -lSDL2 -lSDL2_image
+g++ -c src/command_list.cpp -I./include
 if errorlevel 1 exit /b 1
 
-del main.o graphics.o texture.o camera.o
\ No newline at end of file
+g++ -c src/render_graph.cpp -I./include
+if errorlevel 1 exit /b 1
+
+g++ -c src/thread_pool.cpp -I./include
+if errorlevel 1 exit /b 1
+
+g++ -c src/pixel_convert.cpp -I./include
+if errorlevel 1 exit /b 1
+
+g++ -c src/scene.cpp -I./include
+if errorlevel 1 exit /b 1
+
+g++ -c src/geometry_batch.cpp -I./include
+if errorlevel 1 exit /b 1
+
+g++ -c src/texture_manager.cpp -I./include
+if errorlevel 1 exit /b 1
+
+g++ -c src/file_watcher.cpp -I./include
+if errorlevel 1 exit /b 1
+
+g++ -c src/file_util.cpp -I./include
+if errorlevel 1 exit /b 1
+
+g++ -c src/decoded_cache.cpp -I./include
+if errorlevel 1 exit /b 1
+
+g++ -c src/qoi.cpp -I./include
+if errorlevel 1 exit /b 1
+
+g++ -c src/tiled_document.cpp -I./include
+if errorlevel 1 exit /b 1
+
+g++ -c src/autosave.cpp -I./include
+if errorlevel 1 exit /b 1
+
+g++ -c src/frame_arena.cpp -I./include
+if errorlevel 1 exit /b 1
+
+g++ -c src/brush_mask_cache.cpp -I./include
+if errorlevel 1 exit /b 1
+
+g++ -c src/flood_fill.cpp -I./include
+if errorlevel 1 exit /b 1
+
+g++ -c src/filter.cpp -I./include
+if errorlevel 1 exit /b 1
+
+g++ -c src/layer_stack.cpp -I./include
+if errorlevel 1 exit /b 1
+
+g++ -c src/stroke_buffer.cpp -I./include
+if errorlevel 1 exit /b 1
+
+g++ main.o graphics.o texture.o camera.o command_list.o render_graph.o thread_pool.o pixel_convert.o scene.o geometry_batch.o texture_manager.o file_watcher.o file_util.o decoded_cache.o qoi.o tiled_document.o autosave.o frame_arena.o brush_mask_cache.o flood_fill.o filter.o layer_stack.o stroke_buffer.o -o main.exe -L./lib -lmingw32 -lSDL2main -lSDL2 -lSDL2_image
+if errorlevel 1 exit /b 1
+
+del main.o graphics.o texture.o camera.o command_list.o render_graph.o thread_pool.o pixel_convert.o scene.o geometry_batch.o texture_manager.o file_watcher.o file_util.o decoded_cache.o qoi.o tiled_document.o autosave.o frame_arena.o brush_mask_cache.o flood_fill.o filter.o layer_stack.o stroke_buffer.o
\ No newline at end of file
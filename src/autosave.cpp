@@ -0,0 +1,148 @@
+// autosave.cpp
+#include "autosave.hpp"
+#include "graphics.hpp"
+#include "texture.hpp"
+#include "file_util.hpp"
+#include "qoi.hpp"
+#include "pixel_convert.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <fstream>
+
+namespace {
+
+// Rows encoded between progress updates
+const int kEncodeBand = 64;
+
+} // namespace
+
+AutosaveService::AutosaveService(Graphics& graphics, Texture& canvas, const std::string& path, uint32_t intervalMs)
+    : m_graphics(graphics)
+    , m_canvas(canvas)
+    , m_path(path)
+    , m_interval(intervalMs)
+    , m_lastStart(SDL_GetTicks64())
+    , m_pixels(std::make_shared<std::vector<uint8_t>>())
+{
+}
+
+void AutosaveService::update() {
+    switch (m_state) {
+        case State::Idle: {
+            const bool due = m_interval > 0 && SDL_GetTicks64() - m_lastStart >= m_interval;
+            if (due || m_requested) {
+                beginCapture();
+            }
+            break;
+        }
+        case State::Capturing:
+            captureBand();
+            break;
+        case State::Writing:
+            if (m_job->finished) {
+                finishWrite();
+            }
+            break;
+    }
+}
+
+void AutosaveService::beginCapture() {
+    m_requested = false;
+    m_lastStart = SDL_GetTicks64();
+
+    const int width = m_canvas.getWidth();
+    const int height = m_canvas.getHeight();
+    if (!m_snapshot || m_snapshot->getWidth() != width || m_snapshot->getHeight() != height) {
+        m_snapshot = std::make_unique<Texture>(Texture::create(m_graphics, width, height));
+    }
+
+    // The GPU copy is the snapshot; the canvas is free to change after this
+    m_canvas.render(*m_snapshot, 0, 0, BlendMode::None);
+
+    m_pixels->resize(static_cast<size_t>(width) * height * 4);
+    m_capturedRows = 0;
+    m_state = State::Capturing;
+}
+
+void AutosaveService::captureBand() {
+    const int width = m_snapshot->getWidth();
+    const int height = m_snapshot->getHeight();
+    const int rows = std::min(m_rowsPerFrame, height - m_capturedRows);
+
+    const SDL_Rect band = { 0, m_capturedRows, width, rows };
+    uint8_t* destination = m_pixels->data() + static_cast<size_t>(m_capturedRows) * width * 4;
+    if (!m_snapshot->readPixels(band, destination, width * 4)) {
+        m_progress.failed++;
+        m_state = State::Idle;
+        return;
+    }
+
+    m_capturedRows += rows;
+    if (m_capturedRows >= height) {
+        startWrite();
+    }
+}
+
+void AutosaveService::startWrite() {
+    auto job = std::make_shared<Job>();
+    job->pixels = m_pixels;
+    job->width = m_snapshot->getWidth();
+    job->height = m_snapshot->getHeight();
+    job->pitch = job->width * 4;
+    job->format = m_snapshot->getFormat();
+    job->premultiplied = m_snapshot->isPremultiplied();
+    m_job = job;
+    m_state = State::Writing;
+
+    const std::string path = m_path;
+    ThreadPool::instance().enqueue([job, path]() {
+        const std::string temporary = path + ".tmp";
+        bool success = false;
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            if (file) {
+                Qoi::Encoder encoder(file, job->width, job->height);
+                for (int y = 0; y < job->height; y += kEncodeBand) {
+                    const int rows = std::min(kEncodeBand, job->height - y);
+                    uint8_t* band = job->pixels->data() + static_cast<size_t>(y) * job->pitch;
+                    if (job->premultiplied) {
+                        PixelConvert::unpremultiply(band, job->pitch, job->format, job->width, rows);
+                    }
+                    encoder.writeRows(band, job->pitch, job->format, rows);
+                    job->encodedRows = y + rows;
+                }
+                success = encoder.finish();
+            }
+        }
+        success = success && FileUtil::replaceFile(temporary, path);
+
+        // Hand the buffer back before signalling so the next save can reuse it
+        job->pixels.reset();
+        job->succeeded = success;
+        job->finished = true;
+    });
+}
+
+void AutosaveService::finishWrite() {
+    if (m_job->succeeded) {
+        m_progress.completed++;
+        m_progress.lastSaveTicks = SDL_GetTicks64();
+    } else {
+        m_progress.failed++;
+    }
+    m_job.reset();
+    m_state = State::Idle;
+}
+
+AutosaveService::Progress AutosaveService::getProgress() const {
+    Progress progress = m_progress;
+    progress.state = m_state;
+
+    // Capture and encode each count for half of the save
+    if (m_state == State::Capturing && m_snapshot) {
+        progress.fraction = 0.5f * m_capturedRows / m_snapshot->getHeight();
+    } else if (m_state == State::Writing && m_job) {
+        progress.fraction = 0.5f + 0.5f * m_job->encodedRows / m_job->height;
+    }
+    return progress;
+}
@@ -0,0 +1,90 @@
+// autosave.hpp
+#pragma once
+#include <SDL2/SDL.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+class Graphics;
+class Texture;
+
+// Periodically saves a canvas as a Fast (QOI) snapshot without stalling
+// the render thread for the whole save.
+//
+// A save starts with a GPU copy of the canvas into a pooled render target,
+// so painting can carry on while the copy is read back a band of rows per
+// frame. The pixels are then encoded on the thread pool into a temporary
+// file, which is synced and renamed over the destination. A crash mid-save
+// leaves the previous autosave intact.
+class AutosaveService {
+public:
+    enum class State {
+        Idle,
+        Capturing,      // Reading the snapshot back, a band per frame
+        Writing         // Encoding and writing on the thread pool
+    };
+
+    struct Progress {
+        State state = State::Idle;
+        float fraction = 0.0f;      // Of the save in progress, 0..1
+        int completed = 0;
+        int failed = 0;
+        uint64_t lastSaveTicks = 0; // SDL_GetTicks64() when the last save finished
+    };
+
+    // intervalMs of 0 saves only when requested
+    AutosaveService(Graphics& graphics, Texture& canvas, const std::string& path, uint32_t intervalMs = 60000);
+
+    // Prevent copying
+    AutosaveService(const AutosaveService&) = delete;
+    AutosaveService& operator=(const AutosaveService&) = delete;
+
+    // Advances the save in progress or starts one when due. Call once a
+    // frame on the render thread.
+    void update();
+
+    // Starts a save on the next update() even if the interval hasn't passed
+    void requestSave() { m_requested = true; }
+
+    // Rows read back per frame. Lower values spread the readback over more
+    // frames.
+    void setRowsPerFrame(int rows) { m_rowsPerFrame = rows > 0 ? rows : 1; }
+
+    Progress getProgress() const;
+
+private:
+    // Shared with the encode task, which may outlive the service
+    struct Job {
+        std::shared_ptr<std::vector<uint8_t>> pixels;
+        int width = 0;
+        int height = 0;
+        int pitch = 0;
+        Uint32 format = 0;
+        bool premultiplied = false;     // Converted to straight alpha while encoding
+        std::atomic<int> encodedRows{ 0 };
+        std::atomic<bool> finished{ false };
+        std::atomic<bool> succeeded{ false };
+    };
+
+    void beginCapture();
+    void captureBand();
+    void startWrite();
+    void finishWrite();
+
+    Graphics& m_graphics;
+    Texture& m_canvas;
+    std::string m_path;
+    uint32_t m_interval;
+    uint64_t m_lastStart;
+    bool m_requested = false;
+    int m_rowsPerFrame = 64;
+
+    State m_state = State::Idle;
+    std::unique_ptr<Texture> m_snapshot;                // Pooled GPU copy target
+    std::shared_ptr<std::vector<uint8_t>> m_pixels;     // Reused between saves
+    int m_capturedRows = 0;
+    std::shared_ptr<Job> m_job;
+    Progress m_progress;
+};
@@ -0,0 +1,240 @@
+// brush_mask_cache.cpp
+#include "brush_mask_cache.hpp"
+#include "graphics.hpp"
+#include "texture.hpp"
+#include "pixel_convert.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__)
+#define MUFFIN_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+const float kPi = 3.14159265358979f;
+
+// Quantization steps for the cache key
+const int kHardnessSteps = 64;
+const int kRoundnessSteps = 64;
+const int kAngleSteps = 180;        // Degrees; an ellipse repeats every half turn
+
+// Per-row constants for the coverage kernels
+struct Ellipse {
+    float center;           // Same on both axes
+    float cosine;
+    float sine;
+    float inverseRoundness; // Stretches the minor axis out to the radius
+    float radius;
+    float inverseFade;      // 1 / width of the band coverage falls off over
+    BrushMaskCache::Falloff falloff;
+};
+
+inline float applyFalloff(float k, BrushMaskCache::Falloff falloff) {
+    switch (falloff) {
+        case BrushMaskCache::Falloff::Smooth:
+            return k * k * (3.0f - 2.0f * k);
+        case BrushMaskCache::Falloff::Quadratic:
+            return k * k;
+        case BrushMaskCache::Falloff::Linear:
+        default:
+            return k;
+    }
+}
+
+void coverageRowScalar(const Ellipse& e, float py, uint8_t* out, int begin, int count) {
+    for (int x = begin; x < count; ++x) {
+        const float px = x + 0.5f - e.center;
+        const float u = px * e.cosine + py * e.sine;
+        const float v = (py * e.cosine - px * e.sine) * e.inverseRoundness;
+        const float distance = std::sqrt(u * u + v * v);
+        float k = (e.radius - distance) * e.inverseFade;
+        k = std::min(1.0f, std::max(0.0f, k));
+        out[x] = static_cast<uint8_t>(applyFalloff(k, e.falloff) * 255.0f + 0.5f);
+    }
+}
+
+#ifdef MUFFIN_SSE2
+
+// Four pixels at a time; returns how many were done
+int coverageRowSSE2(const Ellipse& e, float py, uint8_t* out, int count) {
+    const __m128 cosine = _mm_set1_ps(e.cosine);
+    const __m128 sine = _mm_set1_ps(e.sine);
+    const __m128 pyCos = _mm_set1_ps(py * e.cosine);
+    const __m128 pySin = _mm_set1_ps(py * e.sine);
+    const __m128 inverseRoundness = _mm_set1_ps(e.inverseRoundness);
+    const __m128 radius = _mm_set1_ps(e.radius);
+    const __m128 inverseFade = _mm_set1_ps(e.inverseFade);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 three = _mm_set1_ps(3.0f);
+    const __m128 two = _mm_set1_ps(2.0f);
+    const __m128 scale = _mm_set1_ps(255.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 step = _mm_set1_ps(4.0f);
+
+    __m128 px = _mm_add_ps(_mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f), _mm_set1_ps(0.5f - e.center));
+    int x = 0;
+    for (; x + 4 <= count; x += 4) {
+        const __m128 u = _mm_add_ps(_mm_mul_ps(px, cosine), pySin);
+        const __m128 v = _mm_mul_ps(_mm_sub_ps(pyCos, _mm_mul_ps(px, sine)), inverseRoundness);
+        const __m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(u, u), _mm_mul_ps(v, v)));
+        __m128 k = _mm_mul_ps(_mm_sub_ps(radius, distance), inverseFade);
+        k = _mm_min_ps(one, _mm_max_ps(zero, k));
+
+        if (e.falloff == BrushMaskCache::Falloff::Smooth) {
+            k = _mm_mul_ps(_mm_mul_ps(k, k), _mm_sub_ps(three, _mm_mul_ps(two, k)));
+        } else if (e.falloff == BrushMaskCache::Falloff::Quadratic) {
+            k = _mm_mul_ps(k, k);
+        }
+
+        // Round, then narrow 32 -> 16 -> 8 bits; values are already 0..255
+        __m128i values = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(k, scale), half));
+        values = _mm_packs_epi32(values, values);
+        values = _mm_packus_epi16(values, values);
+        const int packed = _mm_cvtsi128_si32(values);
+        std::memcpy(out + x, &packed, 4);
+
+        px = _mm_add_ps(px, step);
+    }
+    return x;
+}
+
+#endif
+
+void coverageRow(const Ellipse& e, int y, uint8_t* out, int count) {
+    const float py = y + 0.5f - e.center;
+    int done = 0;
+#ifdef MUFFIN_SSE2
+    done = coverageRowSSE2(e, py, out, count);
+#endif
+    coverageRowScalar(e, py, out, done, count);
+}
+
+} // namespace
+
+BrushMaskCache::BrushMaskCache(Graphics& graphics, size_t maxEntries)
+    : m_graphics(graphics)
+    , m_maxEntries(std::max<size_t>(1, maxEntries))
+{
+}
+
+BrushMaskCache::~BrushMaskCache() = default;
+
+uint64_t BrushMaskCache::makeKey(const Shape& shape) {
+    const uint64_t size = static_cast<uint64_t>(std::min(65535, std::max(1, shape.size)));
+    const uint64_t hardness = static_cast<uint64_t>(
+        std::lround(std::min(1.0f, std::max(0.0f, shape.hardness)) * kHardnessSteps));
+    const uint64_t roundness = static_cast<uint64_t>(
+        std::lround(std::min(1.0f, std::max(0.01f, shape.roundness)) * kRoundnessSteps));
+
+    // A round brush looks the same at every angle
+    uint64_t angle = 0;
+    if (roundness < static_cast<uint64_t>(kRoundnessSteps)) {
+        long degrees = std::lround(shape.angle * 180.0f / kPi) % kAngleSteps;
+        angle = static_cast<uint64_t>(degrees < 0 ? degrees + kAngleSteps : degrees);
+    }
+
+    return size
+         | (hardness << 16)
+         | (std::max<uint64_t>(1, roundness) << 24)
+         | (angle << 32)
+         | (static_cast<uint64_t>(shape.falloff) << 40);
+}
+
+BrushMaskCache::Shape BrushMaskCache::fromKey(uint64_t key) {
+    Shape shape;
+    shape.size = static_cast<int>(key & 0xFFFF);
+    shape.hardness = static_cast<float>((key >> 16) & 0xFF) / kHardnessSteps;
+    shape.roundness = static_cast<float>((key >> 24) & 0xFF) / kRoundnessSteps;
+    shape.angle = static_cast<float>((key >> 32) & 0xFF) * kPi / 180.0f;
+    shape.falloff = static_cast<Falloff>((key >> 40) & 0xFF);
+    return shape;
+}
+
+std::shared_ptr<Texture> BrushMaskCache::get(const Shape& shape) {
+    const uint64_t key = makeKey(shape);
+    auto it = m_entries.find(key);
+    if (it != m_entries.end()) {
+        m_stats.hits++;
+        m_lru.splice(m_lru.begin(), m_lru, it->second.lru);
+        return it->second.texture;
+    }
+
+    // Generate from the quantized shape so a key always means the same pixels
+    std::shared_ptr<Texture> texture = create(fromKey(key));
+    m_stats.misses++;
+
+    m_lru.push_front(key);
+    m_entries[key] = Entry{ texture, m_lru.begin() };
+    enforceLimit();
+    m_stats.entries = m_entries.size();
+    return texture;
+}
+
+void BrushMaskCache::clear() {
+    m_entries.clear();
+    m_lru.clear();
+    m_stats.entries = 0;
+}
+
+void BrushMaskCache::setMaxEntries(size_t maxEntries) {
+    m_maxEntries = std::max<size_t>(1, maxEntries);
+    enforceLimit();
+    m_stats.entries = m_entries.size();
+}
+
+void BrushMaskCache::enforceLimit() {
+    while (m_entries.size() > m_maxEntries) {
+        m_entries.erase(m_lru.back());
+        m_lru.pop_back();
+        m_stats.evictions++;
+    }
+}
+
+void BrushMaskCache::generate(const Shape& shape, uint8_t* coverage, int pitch) {
+    const int size = shape.size;
+    const float radius = size * 0.5f;
+
+    // Keep at least a pixel of falloff so hard brushes are still antialiased
+    const float inner = std::min(radius * std::min(1.0f, std::max(0.0f, shape.hardness)), radius - 1.0f);
+
+    Ellipse ellipse;
+    ellipse.center = radius;
+    ellipse.cosine = std::cos(shape.angle);
+    ellipse.sine = std::sin(shape.angle);
+    ellipse.inverseRoundness = 1.0f / std::min(1.0f, std::max(0.01f, shape.roundness));
+    ellipse.radius = radius;
+    ellipse.inverseFade = 1.0f / std::max(1.0f, radius - inner);
+    ellipse.falloff = shape.falloff;
+
+    ThreadPool::instance().parallelFor(size, std::max(1, 16384 / std::max(1, size)),
+        [&](int begin, int end) {
+            for (int y = begin; y < end; ++y) {
+                coverageRow(ellipse, y, coverage + static_cast<size_t>(y) * pitch, size);
+            }
+        });
+}
+
+std::shared_ptr<Texture> BrushMaskCache::create(const Shape& shape) {
+    const int size = shape.size;
+    auto texture = std::make_shared<Texture>(Texture::create(m_graphics, size, size));
+
+    // Local buffers rather than frame scratch: masks are made in bursts
+    // (startup, a brush browser) that would leave the arena holding a
+    // block as large as the whole burst
+    std::vector<uint8_t> coverage(static_cast<size_t>(size) * size);
+    generate(shape, coverage.data(), size);
+
+    const Uint32 format = texture->getFormat();
+    std::vector<uint32_t> pixels(static_cast<size_t>(size) * size);
+    PixelConvert::expandAlpha(coverage.data(), size, pixels.data(), size * 4, format, size, size,
+                              texture->isPremultiplied());
+
+    texture->writePixels(SDL_Rect{ 0, 0, size, size }, pixels.data(), size * 4);
+    return texture;
+}
@@ -0,0 +1,83 @@
+// brush_mask_cache.hpp
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <unordered_map>
+
+class Graphics;
+class Texture;
+
+// Generates radial brush masks (white, with coverage in alpha) instead of
+// loading an image and resizing it. Coverage is computed with SIMD in row
+// bands on the shared ThreadPool and uploaded straight to a new texture, so
+// nothing is read back from the GPU.
+//
+// Masks are cached by their quantized shape; changing the brush size back
+// and forth returns textures already made. The least recently requested
+// masks are dropped beyond the entry limit. Callers holding one keep it
+// alive, so dropping never invalidates a mask in use.
+class BrushMaskCache {
+public:
+    enum class Falloff {
+        Linear,
+        Smooth,         // Smoothstep; soft shoulder and soft edge
+        Quadratic       // Falls quickly after the hard core
+    };
+
+    struct Shape {
+        int size = 100;             // Width and height in pixels
+        float hardness = 0.5f;      // 0..1, fraction of the radius at full coverage
+        float roundness = 1.0f;     // 0..1, minor to major axis ratio
+        float angle = 0.0f;         // Radians, clockwise; only matters when not round
+        Falloff falloff = Falloff::Smooth;
+    };
+
+    struct Stats {
+        int hits = 0;
+        int misses = 0;             // Masks generated
+        int evictions = 0;
+        size_t entries = 0;
+    };
+
+    explicit BrushMaskCache(Graphics& graphics, size_t maxEntries = 32);
+    ~BrushMaskCache();
+
+    // Prevent copying
+    BrushMaskCache(const BrushMaskCache&) = delete;
+    BrushMaskCache& operator=(const BrushMaskCache&) = delete;
+
+    // Returns the mask for shape, generating it if it isn't cached. Throws
+    // if the texture can't be created.
+    std::shared_ptr<Texture> get(const Shape& shape);
+
+    void clear();
+
+    void setMaxEntries(size_t maxEntries);
+    size_t getMaxEntries() const { return m_maxEntries; }
+
+    const Stats& getStats() const { return m_stats; }
+
+    // Fills size x size coverage values, 0..255, for shape. Safe to call
+    // from any thread.
+    static void generate(const Shape& shape, uint8_t* coverage, int pitch);
+
+private:
+    struct Entry {
+        std::shared_ptr<Texture> texture;
+        std::list<uint64_t>::iterator lru;
+    };
+
+    // Quantizes shape so nearly equal ones share a mask
+    static uint64_t makeKey(const Shape& shape);
+    static Shape fromKey(uint64_t key);
+    std::shared_ptr<Texture> create(const Shape& shape);
+    void enforceLimit();
+
+    Graphics& m_graphics;
+    size_t m_maxEntries;
+    std::unordered_map<uint64_t, Entry> m_entries;
+    std::list<uint64_t> m_lru;          // Most recently requested first
+    Stats m_stats;
+};
@@ -1,11 +1,18 @@
 // camera.cpp
 #include "camera.hpp"
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64)
+#define MUFFIN_SSE 1
+#include <xmmintrin.h>
+#endif
 
 Camera::Camera()
     : m_x(0.0f)
     , m_y(0.0f)
     , m_zoom(1.0f)
 {
+    updateTransform();
 }
 
 Camera::Camera(float x, float y, float zoom)
@@ -13,11 +20,26 @@ Camera::Camera(float x, float y, float zoom)
     , m_y(y)
     , m_zoom(zoom)
 {
+    updateTransform();
+}
+
+void Camera::updateTransform() {
+    // screen = zoom * R(rotation) * (world - position)
+    const float cosine = std::cos(m_rotation) * m_zoom;
+    const float sine = std::sin(m_rotation) * m_zoom;
+    m_worldToScreen = Transform2D{
+        cosine, sine,
+        -sine, cosine,
+        -(cosine * m_x - sine * m_y),
+        -(sine * m_x + cosine * m_y)
+    };
+    m_screenToWorld = m_worldToScreen.inverse();
 }
 
 void Camera::pan(float dx, float dy) {
     m_x += dx;
     m_y += dy;
+    updateTransform();
 }
 
 void Camera::zoomAtPoint(float factor, int screenX, int screenY) {
@@ -26,8 +48,8 @@ void Camera::zoomAtPoint(float factor, int screenX, int screenY) {
     screenToWorld(screenX, screenY, worldX, worldY);
     
     // Apply zoom
-    float oldZoom = m_zoom;
     m_zoom *= factor;
+    updateTransform();
     
     // Adjust camera position to keep worldX,worldY at the same screen position
     float newWorldX, newWorldY;
@@ -35,14 +57,111 @@ void Camera::zoomAtPoint(float factor, int screenX, int screenY) {
     
     m_x += worldX - newWorldX;
     m_y += worldY - newWorldY;
+    updateTransform();
+}
+
+void Camera::rotateAtPoint(float radians, int screenX, int screenY) {
+    float worldX, worldY;
+    screenToWorld(screenX, screenY, worldX, worldY);
+
+    setRotation(m_rotation + radians);
+
+    // Shift the camera so the pivot's world point stays under the pivot
+    float newWorldX, newWorldY;
+    screenToWorld(screenX, screenY, newWorldX, newWorldY);
+
+    m_x += worldX - newWorldX;
+    m_y += worldY - newWorldY;
+    updateTransform();
+}
+
+void Camera::setRotation(float radians) {
+    const float fullTurn = 6.28318530718f;
+    m_rotation = std::fmod(radians, fullTurn);
+    if (m_rotation < 0.0f) {
+        m_rotation += fullTurn;
+    }
+    updateTransform();
 }
 
 void Camera::worldToScreen(float worldX, float worldY, int& screenX, int& screenY) const {
-    screenX = static_cast<int>((worldX - m_x) * m_zoom);
-    screenY = static_cast<int>((worldY - m_y) * m_zoom);
+    Vec2f screen = m_worldToScreen.apply(worldX, worldY);
+    screenX = static_cast<int>(screen.x);
+    screenY = static_cast<int>(screen.y);
 }
 
 void Camera::screenToWorld(int screenX, int screenY, float& worldX, float& worldY) const {
-    worldX = (screenX / m_zoom) + m_x;
-    worldY = (screenY / m_zoom) + m_y;
+    screenToWorld(static_cast<float>(screenX), static_cast<float>(screenY), worldX, worldY);
+}
+
+void Camera::worldToScreen(float worldX, float worldY, float& screenX, float& screenY) const {
+    Vec2f screen = m_worldToScreen.apply(worldX, worldY);
+    screenX = screen.x;
+    screenY = screen.y;
+}
+
+void Camera::screenToWorld(float screenX, float screenY, float& worldX, float& worldY) const {
+    Vec2f world = m_screenToWorld.apply(screenX, screenY);
+    worldX = world.x;
+    worldY = world.y;
+}
+
+void Camera::worldToScreen(const Vec2f* world, Vec2f* screen, size_t count) const {
+    const Transform2D& m = m_worldToScreen;
+    size_t i = 0;
+
+#ifdef MUFFIN_SSE
+    // Two interleaved points per register: (x0, y0, x1, y1)
+    //   out = v * (a, d, a, d) + swap(v) * (c, b, c, b) + (tx, ty, tx, ty)
+    const __m128 diagonal = _mm_setr_ps(m.a, m.d, m.a, m.d);
+    const __m128 cross = _mm_setr_ps(m.c, m.b, m.c, m.b);
+    const __m128 offset = _mm_setr_ps(m.tx, m.ty, m.tx, m.ty);
+    const float* in = reinterpret_cast<const float*>(world);
+    float* out = reinterpret_cast<float*>(screen);
+
+    for (; i + 4 <= count; i += 4) {
+        __m128 v0 = _mm_loadu_ps(in + i * 2);
+        __m128 v1 = _mm_loadu_ps(in + i * 2 + 4);
+        __m128 s0 = _mm_shuffle_ps(v0, v0, _MM_SHUFFLE(2, 3, 0, 1));
+        __m128 s1 = _mm_shuffle_ps(v1, v1, _MM_SHUFFLE(2, 3, 0, 1));
+        v0 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(v0, diagonal), _mm_mul_ps(s0, cross)), offset);
+        v1 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(v1, diagonal), _mm_mul_ps(s1, cross)), offset);
+        _mm_storeu_ps(out + i * 2, v0);
+        _mm_storeu_ps(out + i * 2 + 4, v1);
+    }
+#endif
+
+    for (; i < count; ++i) {
+        screen[i] = m.apply(world[i].x, world[i].y);
+    }
+}
+
+void Camera::setViewport(int x, int y, int width, int height) {
+    m_viewport = Rectangle{
+        static_cast<float>(x), static_cast<float>(y),
+        static_cast<float>(width), static_cast<float>(height)
+    };
+}
+
+Rectangle Camera::visibleWorldRect() const {
+    return visibleWorldRect(m_viewport);
+}
+
+Rectangle Camera::visibleWorldRect(const Rectangle& screen) const {
+    const Vec2f corners[4] = {
+        m_screenToWorld.apply(screen.x, screen.y),
+        m_screenToWorld.apply(screen.right(), screen.y),
+        m_screenToWorld.apply(screen.right(), screen.bottom()),
+        m_screenToWorld.apply(screen.x, screen.bottom())
+    };
+
+    float left = corners[0].x, right = corners[0].x;
+    float top = corners[0].y, bottom = corners[0].y;
+    for (const Vec2f& corner : corners) {
+        left = std::min(left, corner.x);
+        right = std::max(right, corner.x);
+        top = std::min(top, corner.y);
+        bottom = std::max(bottom, corner.y);
+    }
+    return Rectangle{ left, top, right - left, bottom - top };
 }
\ No newline at end of file
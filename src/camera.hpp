@@ -1,5 +1,6 @@
 // camera.hpp
 #pragma once
+#include "geometry.hpp"
 
 class Camera {
 public:
@@ -9,18 +10,55 @@ public:
     // Core operations
     void pan(float dx, float dy);
     void zoomAtPoint(float factor, int screenX, int screenY);
+
+    // Rotation in radians, clockwise on screen. rotateAtPoint keeps the
+    // world point under the pivot fixed, like zoomAtPoint.
+    void rotateAtPoint(float radians, int screenX, int screenY);
+    void setRotation(float radians);
+    bool isRotated() const { return m_rotation != 0.0f; }
     
     // Coordinate conversion
     void worldToScreen(float worldX, float worldY, int& screenX, int& screenY) const;
     void screenToWorld(int screenX, int screenY, float& worldX, float& worldY) const;
 
+    // Sub-pixel conversion for float draw paths
+    void worldToScreen(float worldX, float worldY, float& screenX, float& screenY) const;
+    void screenToWorld(float screenX, float screenY, float& worldX, float& worldY) const;
+
+    // Transforms count points at once; in and out may be the same array
+    void worldToScreen(const Vec2f* world, Vec2f* screen, size_t count) const;
+
+    // World to screen matrix, rebuilt whenever the camera moves or zooms
+    const Transform2D& getTransform() const { return m_worldToScreen; }
+
+    // Viewport: the screen area the camera draws into. Render paths skip
+    // anything outside it. Without one, the renderer's viewport is used.
+    void setViewport(int x, int y, int width, int height);
+    void clearViewport() { m_viewport = Rectangle{}; }
+    bool hasViewport() const { return !m_viewport.isEmpty(); }
+    const Rectangle& getViewport() const { return m_viewport; }
+
+    // World-space area covered by the viewport; the bounding box of the
+    // viewport's corners when the camera is rotated
+    Rectangle visibleWorldRect() const;
+
+    // The same for any screen rect, e.g. the renderer's viewport
+    Rectangle visibleWorldRect(const Rectangle& screen) const;
+
     // Accessors
     float getX() const { return m_x; }
     float getY() const { return m_y; }
     float getZoom() const { return m_zoom; }
+    float getRotation() const { return m_rotation; }
 
 private:
+    void updateTransform();
+
     float m_x;      // Camera position in world space
     float m_y;
     float m_zoom;   // Zoom factor (1.0 = no zoom)
+    float m_rotation = 0.0f;    // Radians
+    Rectangle m_viewport;   // Screen space, empty when unset
+    Transform2D m_worldToScreen;
+    Transform2D m_screenToWorld;
 };
\ No newline at end of file
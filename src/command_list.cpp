@@ -0,0 +1,210 @@
+// command_list.cpp
+#include "command_list.hpp"
+#include "graphics.hpp"
+#include <algorithm>
+
+CommandList::CommandList(int order)
+    : m_order(order)
+{
+}
+
+void CommandList::clear(Texture& target, uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    Command command = {};
+    command.type = Type::Clear;
+    command.target = &target;
+    command.color = Color{r, g, b, a};
+    m_commands.push_back(command);
+}
+
+void CommandList::draw(Texture& source, int x, int y, BlendMode mode) {
+    Command command = {};
+    command.type = Type::Draw;
+    command.source = &source;
+    command.target = nullptr;
+    command.destX = x;
+    command.destY = y;
+    command.mode = mode;
+    m_commands.push_back(command);
+}
+
+void CommandList::copy(Texture& source, Texture& target, int destX, int destY, BlendMode mode) {
+    Command command = {};
+    command.type = Type::Copy;
+    command.source = &source;
+    command.target = &target;
+    command.destX = destX;
+    command.destY = destY;
+    command.mode = mode;
+    m_commands.push_back(command);
+}
+
+void CommandList::copy(Texture& source, Texture& target,
+                       int sourceX, int sourceY, int sourceWidth, int sourceHeight,
+                       int destX, int destY, BlendMode mode) {
+    Command command = {};
+    command.type = Type::CopyRegion;
+    command.source = &source;
+    command.target = &target;
+    command.sourceRect = { sourceX, sourceY, sourceWidth, sourceHeight };
+    command.destX = destX;
+    command.destY = destY;
+    command.mode = mode;
+    m_commands.push_back(command);
+}
+
+void CommandList::applyMask(Texture& target, Texture& mask) {
+    Command command = {};
+    command.type = Type::ApplyMask;
+    command.source = &mask;
+    command.target = &target;
+    m_commands.push_back(command);
+}
+
+CommandQueue::CommandQueue(Graphics& graphics)
+    : m_graphics(graphics)
+{
+}
+
+void CommandQueue::submit(CommandList&& list) {
+    if (list.empty()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_pending.push_back(Submission{ std::move(list), m_nextSequence++ });
+}
+
+bool CommandQueue::validate(const CommandList::Command& command) const {
+    using Type = CommandList::Type;
+
+    // Moved-from Textures keep their address but lose their SDL texture
+    if (command.target && !command.target->m_texture) {
+        return false;
+    }
+    if (command.type == Type::Clear) {
+        return command.target != nullptr;
+    }
+    if (!command.source || !command.source->m_texture) {
+        return false;
+    }
+    if (command.source == command.target) {
+        return false;
+    }
+
+    switch (command.type) {
+        case Type::Draw:
+            return command.target == nullptr;
+        case Type::Copy:
+            return command.target != nullptr;
+        case Type::CopyRegion:
+            // Source coordinates wrap, so only the size needs checking
+            return command.target != nullptr
+                && command.sourceRect.w > 0 && command.sourceRect.h > 0;
+        case Type::ApplyMask:
+            return command.target != nullptr
+                && command.source->getWidth() == command.target->getWidth()
+                && command.source->getHeight() == command.target->getHeight();
+        default:
+            return false;
+    }
+}
+
+void CommandQueue::run(const CommandList::Command& command) {
+    using Type = CommandList::Type;
+
+    switch (command.type) {
+        case Type::Clear:
+            command.target->clear(command.color.r, command.color.g, command.color.b, command.color.a);
+            break;
+        case Type::Draw:
+            command.source->render(command.destX, command.destY, nullptr, command.mode);
+            break;
+        case Type::Copy:
+            command.source->render(*command.target, command.destX, command.destY, command.mode);
+            break;
+        case Type::CopyRegion:
+            command.source->render(*command.target,
+                                   command.sourceRect.x, command.sourceRect.y,
+                                   command.sourceRect.w, command.sourceRect.h,
+                                   command.destX, command.destY, command.mode);
+            break;
+        case Type::ApplyMask:
+            command.target->applyMask(*command.source);
+            break;
+    }
+}
+
+size_t CommandQueue::execute() {
+    using Type = CommandList::Type;
+
+    std::vector<Submission> submissions;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        submissions.swap(m_pending);
+    }
+
+    m_stats = Stats();
+
+    std::stable_sort(submissions.begin(), submissions.end(),
+        [](const Submission& a, const Submission& b) {
+            if (a.list.getOrder() != b.list.getOrder()) {
+                return a.list.getOrder() < b.list.getOrder();
+            }
+            return a.sequence < b.sequence;
+        });
+
+    // Validate and flatten every list into a single ordered stream
+    std::vector<const CommandList::Command*> commands;
+    for (const Submission& submission : submissions) {
+        for (const CommandList::Command& command : submission.list.m_commands) {
+            if (!validate(command)) {
+                m_stats.rejected++;
+                continue;
+            }
+            commands.push_back(&command);
+        }
+    }
+
+    SDL_Renderer* renderer = m_graphics.getRenderer();
+    SDL_Texture* previousTarget = SDL_GetRenderTarget(renderer);
+
+    // Runs of commands on the same target share a single target bind; the
+    // per-call bind inside Texture then becomes a no-op in SDL.
+    bool bound = false;
+    Texture* boundTarget = nullptr;
+
+    for (size_t i = 0; i < commands.size(); ++i) {
+        const CommandList::Command& command = *commands[i];
+
+        // A clear that is immediately followed by another clear of the same
+        // target has no visible effect
+        if (command.type == Type::Clear && i + 1 < commands.size()
+            && commands[i + 1]->type == Type::Clear && commands[i + 1]->target == command.target) {
+            m_stats.merged++;
+            continue;
+        }
+
+        if (command.type == Type::ApplyMask) {
+            // applyMask replaces the target's SDL texture, so it manages its
+            // own binding and invalidates ours
+            run(command);
+            bound = false;
+            m_stats.executed++;
+            continue;
+        }
+
+        if (!bound || boundTarget != command.target) {
+            SDL_SetRenderTarget(renderer, command.target ? command.target->m_texture : nullptr);
+            boundTarget = command.target;
+            bound = true;
+            m_stats.targetBinds++;
+        }
+
+        run(command);
+        m_stats.executed++;
+    }
+
+    SDL_SetRenderTarget(renderer, previousTarget);
+
+    return m_stats.executed;
+}
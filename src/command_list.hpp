@@ -0,0 +1,103 @@
+// command_list.hpp
+#pragma once
+#include <SDL2/SDL.h>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include "texture.hpp"
+
+class Graphics;
+
+// Records Texture operations without touching SDL, so worker threads can
+// build their own lists in parallel. Finished lists are handed to a
+// CommandQueue, which executes them on the render thread.
+//
+// A CommandList only stores pointers to the Textures it references; those
+// Textures must outlive the CommandQueue::execute() call that runs the list.
+class CommandList {
+public:
+    // Lists are executed in ascending order, then in submission order
+    explicit CommandList(int order = 0);
+
+    // Recording
+    void clear(Texture& target, uint8_t r = 0, uint8_t g = 0, uint8_t b = 0, uint8_t a = 0);
+    void draw(Texture& source, int x, int y, BlendMode mode = BlendMode::Alpha);
+    void copy(Texture& source, Texture& target, int destX, int destY,
+              BlendMode mode = BlendMode::Alpha);
+    void copy(Texture& source, Texture& target,
+              int sourceX, int sourceY, int sourceWidth, int sourceHeight,
+              int destX, int destY, BlendMode mode = BlendMode::Alpha);
+    void applyMask(Texture& target, Texture& mask);
+
+    // Properties
+    int getOrder() const { return m_order; }
+    size_t size() const { return m_commands.size(); }
+    bool empty() const { return m_commands.empty(); }
+    void reset() { m_commands.clear(); }
+
+private:
+    friend class CommandQueue;
+
+    enum class Type {
+        Clear,
+        Draw,
+        Copy,
+        CopyRegion,
+        ApplyMask
+    };
+
+    struct Command {
+        Type type;
+        Texture* source;    // Texture being drawn (or the mask for ApplyMask)
+        Texture* target;    // nullptr means the screen
+        SDL_Rect sourceRect;
+        int destX;
+        int destY;
+        BlendMode mode;
+        Color color;
+    };
+
+    int m_order;
+    std::vector<Command> m_commands;
+};
+
+class CommandQueue {
+public:
+    explicit CommandQueue(Graphics& graphics);
+
+    // Prevent copying
+    CommandQueue(const CommandQueue&) = delete;
+    CommandQueue& operator=(const CommandQueue&) = delete;
+
+    // Safe to call from any thread
+    void submit(CommandList&& list);
+
+    // Render thread only. Runs every submitted list and returns the number
+    // of commands that reached SDL.
+    size_t execute();
+
+    struct Stats {
+        size_t executed = 0;        // Commands issued to SDL
+        size_t rejected = 0;        // Commands that failed validation
+        size_t merged = 0;          // Commands dropped because a later one made them redundant
+        size_t targetBinds = 0;     // Render target switches performed
+    };
+
+    // Statistics for the most recent execute()
+    const Stats& getStats() const { return m_stats; }
+
+private:
+    struct Submission {
+        CommandList list;
+        uint64_t sequence;
+    };
+
+    bool validate(const CommandList::Command& command) const;
+    void run(const CommandList::Command& command);
+
+    Graphics& m_graphics;
+    std::mutex m_mutex;
+    std::vector<Submission> m_pending;
+    uint64_t m_nextSequence = 0;
+    Stats m_stats;
+};
@@ -0,0 +1,152 @@
+// decoded_cache.cpp
+#include "decoded_cache.hpp"
+#include "thread_pool.hpp"
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace {
+
+const char kMagic[4] = { 'M', 'G', 'D', 'C' };
+const uint32_t kVersion = 1;
+
+struct Header {
+    char magic[4];
+    uint32_t version;
+    uint32_t format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t pitch;         // Bytes per row of the pixel data that follows
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    uint64_t sourceHash;
+};
+
+bool hashFile(const std::string& path, uint64_t& hash) {
+    MappedFile source(path);
+    if (!source.isOpen()) {
+        return false;
+    }
+    hash = FileUtil::hash(source.data(), source.size());
+    return true;
+}
+
+} // namespace
+
+DecodedCache::DecodedCache(const std::string& directory)
+    : m_directory(directory)
+    , m_stats(std::make_shared<Stats>())
+{
+    std::error_code ignored;
+    std::filesystem::create_directories(directory, ignored);
+}
+
+std::string DecodedCache::entryPath(const std::string& sourcePath) const {
+    std::error_code error;
+    std::filesystem::path canonical = std::filesystem::weakly_canonical(sourcePath, error);
+    const std::string key = error ? sourcePath : canonical.string();
+
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.raw",
+                  static_cast<unsigned long long>(FileUtil::hash(key.data(), key.size())));
+    return (std::filesystem::path(m_directory) / name).string();
+}
+
+bool DecodedCache::lookup(const std::string& path, Uint32 format, DecodedImage& image) {
+    FileUtil::FileInfo info;
+    if (!FileUtil::getInfo(path, info)) {
+        m_stats->misses++;
+        return false;
+    }
+
+    const std::string cachePath = entryPath(path);
+    MappedFile file(cachePath);
+    if (!file.isOpen() || file.size() < sizeof(Header)) {
+        m_stats->misses++;
+        return false;
+    }
+
+    Header header;
+    std::memcpy(&header, file.data(), sizeof(Header));
+    const bool valid = std::memcmp(header.magic, kMagic, sizeof(kMagic)) == 0
+        && header.version == kVersion
+        && header.format == format
+        && header.sourceSize == info.size
+        && header.pitch >= header.width * SDL_BYTESPERPIXEL(format)
+        && file.size() >= sizeof(Header) + static_cast<size_t>(header.pitch) * header.height;
+    if (!valid) {
+        m_stats->misses++;
+        return false;
+    }
+
+    if (header.sourceTime != info.modifiedTime) {
+        uint64_t hash = 0;
+        if (!hashFile(path, hash) || hash != header.sourceHash) {
+            m_stats->misses++;
+            return false;
+        }
+
+        // Same contents, new time: record it so the next run skips the hash
+        const int64_t time = info.modifiedTime;
+        ThreadPool::instance().enqueue([cachePath, time]() {
+            std::fstream patch(cachePath, std::ios::binary | std::ios::in | std::ios::out);
+            if (patch) {
+                patch.seekp(offsetof(Header, sourceTime));
+                patch.write(reinterpret_cast<const char*>(&time), sizeof(time));
+            }
+        });
+    }
+
+    image.pixels = file.data() + sizeof(Header);
+    image.pitch = static_cast<int>(header.pitch);
+    image.width = static_cast<int>(header.width);
+    image.height = static_cast<int>(header.height);
+    image.file = std::move(file);
+    m_stats->hits++;
+    return true;
+}
+
+void DecodedCache::store(const std::string& path, const SDL_Surface* surface) {
+    FileUtil::FileInfo info;
+    if (!FileUtil::getInfo(path, info) || SDL_BYTESPERPIXEL(surface->format->format) != 4) {
+        return;
+    }
+
+    Header header;
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.format = surface->format->format;
+    header.width = static_cast<uint32_t>(surface->w);
+    header.height = static_cast<uint32_t>(surface->h);
+    header.pitch = static_cast<uint32_t>(surface->w * 4);
+    header.sourceSize = info.size;
+    header.sourceTime = info.modifiedTime;
+    header.sourceHash = 0;
+
+    // Copy tightly packed rows now; the surface may be gone by the time the
+    // task runs
+    auto pixels = std::make_shared<std::vector<uint8_t>>(static_cast<size_t>(header.pitch) * header.height);
+    for (int y = 0; y < surface->h; ++y) {
+        std::memcpy(pixels->data() + static_cast<size_t>(y) * header.pitch,
+                    static_cast<const uint8_t*>(surface->pixels) + static_cast<size_t>(y) * surface->pitch,
+                    header.pitch);
+    }
+
+    std::shared_ptr<Stats> stats = m_stats;
+    const std::string cachePath = entryPath(path);
+    ThreadPool::instance().enqueue([stats, path, cachePath, header, pixels]() mutable {
+        // Skip the write if the source changed after it was decoded
+        FileUtil::FileInfo current;
+        if (!FileUtil::getInfo(path, current)
+            || current.size != header.sourceSize || current.modifiedTime != header.sourceTime
+            || !hashFile(path, header.sourceHash)) {
+            return;
+        }
+        if (FileUtil::writeAtomically(cachePath, &header, sizeof(header), pixels->data(), pixels->size())) {
+            stats->writes++;
+        }
+    });
+}
@@ -0,0 +1,54 @@
+// decoded_cache.hpp
+#pragma once
+#include <SDL2/SDL.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include "file_util.hpp"
+
+// Pixels of a cache hit, read straight from the mapped cache file
+struct DecodedImage {
+    MappedFile file;
+    const void* pixels = nullptr;
+    int pitch = 0;
+    int width = 0;
+    int height = 0;
+};
+
+// On-disk cache of decoded images in the renderer's native format, so later
+// runs can skip PNG decoding and format conversion. There is one file per
+// source path, holding a small header and the raw pixels.
+//
+// An entry is current when the source's size and modification time match
+// the header. If only the time differs, the source is hashed and compared
+// with the stored hash, so touching a file doesn't force a rebuild. Misses
+// are written back on the shared ThreadPool.
+class DecodedCache {
+public:
+    struct Stats {
+        std::atomic<int> hits{ 0 };
+        std::atomic<int> misses{ 0 };
+        std::atomic<int> writes{ 0 };      // Entries written back
+    };
+
+    explicit DecodedCache(const std::string& directory);
+
+    // Prevent copying
+    DecodedCache(const DecodedCache&) = delete;
+    DecodedCache& operator=(const DecodedCache&) = delete;
+
+    // Maps the cached pixels for path if they are current and in format
+    bool lookup(const std::string& path, Uint32 format, DecodedImage& image);
+
+    // Queues the decoded pixels of path to be written for next time. The
+    // surface is copied, so the caller keeps it.
+    void store(const std::string& path, const SDL_Surface* surface);
+
+    const Stats& getStats() const { return *m_stats; }
+
+private:
+    std::string entryPath(const std::string& sourcePath) const;
+
+    std::string m_directory;
+    std::shared_ptr<Stats> m_stats;     // Shared with write-back tasks
+};
@@ -0,0 +1,64 @@
+// file_util.hpp
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Read-only memory mapping of a whole file. Empty (isOpen() false) if the
+// file couldn't be opened or mapped.
+class MappedFile {
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    // Prevent copying
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Allow moving
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    bool isOpen() const { return m_data != nullptr; }
+    const uint8_t* data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+    void close();
+
+private:
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+#ifdef _WIN32
+    void* m_file = nullptr;     // HANDLEs, kept as void* to keep windows.h out
+    void* m_mapping = nullptr;
+#endif
+};
+
+namespace FileUtil {
+
+    // Size and modification time of a file. The time is only meaningful for
+    // comparing against another value from this function.
+    struct FileInfo {
+        uint64_t size = 0;
+        int64_t modifiedTime = 0;
+    };
+
+    bool getInfo(const std::string& path, FileInfo& info);
+
+    // 64-bit FNV-1a
+    uint64_t hash(const void* data, size_t size, uint64_t seed = 0xcbf29ce484222325ULL);
+
+    // Flushes the file's written data to disk
+    bool sync(const std::string& path);
+
+    // Syncs temporary and renames it over path
+    bool replaceFile(const std::string& temporary, const std::string& path);
+
+    // Writes header then body to a temporary file and renames it over path,
+    // so readers never see a partly written file
+    bool writeAtomically(const std::string& path,
+                         const void* header, size_t headerSize,
+                         const void* body, size_t bodySize);
+
+}
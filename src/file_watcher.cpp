@@ -0,0 +1,155 @@
+// file_watcher.cpp
+#include "file_watcher.hpp"
+#include <filesystem>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// How long a file must go without events before it is reported
+const auto kSettleTime = std::chrono::milliseconds(50);
+
+std::string canonicalPath(const std::filesystem::path& path) {
+    std::error_code error;
+    std::filesystem::path canonical = std::filesystem::weakly_canonical(path, error);
+    return error ? path.string() : canonical.string();
+}
+
+} // namespace
+
+#ifdef __linux__
+
+FileWatcher::FileWatcher() {
+    m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_fd >= 0) {
+        m_thread = std::thread(&FileWatcher::readLoop, this);
+    }
+}
+
+FileWatcher::~FileWatcher() {
+    m_stopping = true;
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    if (m_fd >= 0) {
+        close(m_fd);
+    }
+}
+
+bool FileWatcher::isSupported() {
+    return true;
+}
+
+bool FileWatcher::addDirectory(const std::string& directory) {
+    std::error_code error;
+    if (m_fd < 0 || !std::filesystem::is_directory(directory, error)) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    watchTree(canonicalPath(directory));
+    return true;
+}
+
+// Caller holds m_mutex
+void FileWatcher::watchTree(const std::string& directory) {
+    const uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE;
+    int wd = inotify_add_watch(m_fd, directory.c_str(), mask);
+    if (wd >= 0) {
+        m_directories[wd] = directory;
+    }
+
+    std::error_code error;
+    for (std::filesystem::recursive_directory_iterator it(directory, error), end; !error && it != end; it.increment(error)) {
+        if (it->is_directory(error)) {
+            wd = inotify_add_watch(m_fd, it->path().c_str(), mask);
+            if (wd >= 0) {
+                m_directories[wd] = canonicalPath(it->path());
+            }
+        }
+    }
+}
+
+void FileWatcher::readLoop() {
+    // Large enough for many events; aligned for inotify_event
+    alignas(inotify_event) char buffer[16 * 1024];
+
+    while (!m_stopping) {
+        // Wake up regularly to notice m_stopping
+        pollfd descriptor = { m_fd, POLLIN, 0 };
+        if (::poll(&descriptor, 1, 100) <= 0) {
+            continue;
+        }
+
+        ssize_t length = read(m_fd, buffer, sizeof(buffer));
+        if (length <= 0) {
+            continue;
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const auto now = Clock::now();
+        for (char* cursor = buffer; cursor < buffer + length;) {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(cursor);
+            cursor += sizeof(inotify_event) + event->len;
+
+            auto directory = m_directories.find(event->wd);
+            if (directory == m_directories.end() || event->len == 0) {
+                continue;
+            }
+            const std::string path = directory->second + "/" + event->name;
+
+            if (event->mask & IN_ISDIR) {
+                // New subdirectories are watched too; files already in them
+                // are picked up on their next write
+                if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                    watchTree(path);
+                }
+                continue;
+            }
+            // A new file is reported when its writer closes it
+            if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+                m_pending[path] = now;
+            }
+        }
+    }
+}
+
+#else
+
+FileWatcher::FileWatcher() {
+}
+
+FileWatcher::~FileWatcher() {
+}
+
+bool FileWatcher::isSupported() {
+    return false;
+}
+
+bool FileWatcher::addDirectory(const std::string&) {
+    return false;
+}
+
+void FileWatcher::watchTree(const std::string&) {
+}
+
+void FileWatcher::readLoop() {
+}
+
+#endif
+
+void FileWatcher::poll(std::vector<std::string>& changed) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const auto now = Clock::now();
+    for (auto it = m_pending.begin(); it != m_pending.end();) {
+        if (now - it->second >= kSettleTime) {
+            changed.push_back(it->first);
+            it = m_pending.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
@@ -0,0 +1,49 @@
+// file_watcher.hpp
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Reports files that were written or moved into watched directories.
+// Directories are watched recursively, including ones created later. Uses
+// inotify on Linux; on other platforms isSupported() is false and nothing
+// is ever reported.
+//
+// Events are read on a background thread. A file is reported once it has
+// been quiet for a short settle time, so an editor's save sequence
+// (truncate, write, rename) comes through as a single change.
+class FileWatcher {
+public:
+    FileWatcher();
+    ~FileWatcher();
+
+    // Prevent copying
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    static bool isSupported();
+
+    // Returns false if the directory can't be watched
+    bool addDirectory(const std::string& directory);
+
+    // Appends the canonical paths of files that changed and have settled
+    // since the last call
+    void poll(std::vector<std::string>& changed);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void watchTree(const std::string& directory);
+    void readLoop();
+
+    int m_fd = -1;
+    std::mutex m_mutex;
+    std::unordered_map<int, std::string> m_directories;        // Watch descriptor -> directory
+    std::unordered_map<std::string, Clock::time_point> m_pending;   // Path -> last event time
+    std::atomic<bool> m_stopping{ false };
+    std::thread m_thread;
+};
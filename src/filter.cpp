@@ -0,0 +1,335 @@
+// filter.cpp
+#include "filter.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__)
+#define MUFFIN_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// Tiles are small enough that their float scratch mostly stays in cache
+const int kTileSize = 128;
+
+// Sigmas up to this use an exact kernel; above it three box passes
+const float kKernelSigmaLimit = 1.0f;
+
+// One pixel as four floats, whatever its byte order
+#ifdef MUFFIN_SSE2
+
+struct Vec4 {
+    __m128 v;
+};
+
+inline Vec4 zero() { return Vec4{ _mm_setzero_ps() }; }
+inline Vec4 splat(float value) { return Vec4{ _mm_set1_ps(value) }; }
+inline Vec4 operator+(Vec4 a, Vec4 b) { return Vec4{ _mm_add_ps(a.v, b.v) }; }
+inline Vec4 operator-(Vec4 a, Vec4 b) { return Vec4{ _mm_sub_ps(a.v, b.v) }; }
+inline Vec4 operator*(Vec4 a, Vec4 b) { return Vec4{ _mm_mul_ps(a.v, b.v) }; }
+
+inline Vec4 loadPixel(const uint8_t* pixel) {
+    int packed;
+    std::memcpy(&packed, pixel, 4);
+    const __m128i bytes = _mm_cvtsi32_si128(packed);
+    const __m128i empty = _mm_setzero_si128();
+    return Vec4{ _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(bytes, empty), empty)) };
+}
+
+inline void storePixel(Vec4 value, uint8_t* pixel) {
+    __m128i words = _mm_cvtps_epi32(value.v);
+    words = _mm_packs_epi32(words, words);
+    words = _mm_packus_epi16(words, words);
+    const int packed = _mm_cvtsi128_si32(words);
+    std::memcpy(pixel, &packed, 4);
+}
+
+#else
+
+struct Vec4 {
+    float v[4];
+};
+
+inline Vec4 zero() { return Vec4{ { 0.0f, 0.0f, 0.0f, 0.0f } }; }
+inline Vec4 splat(float value) { return Vec4{ { value, value, value, value } }; }
+inline Vec4 operator+(Vec4 a, Vec4 b) { return Vec4{ { a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3] } }; }
+inline Vec4 operator-(Vec4 a, Vec4 b) { return Vec4{ { a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3] } }; }
+inline Vec4 operator*(Vec4 a, Vec4 b) { return Vec4{ { a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3] } }; }
+
+inline Vec4 loadPixel(const uint8_t* pixel) {
+    return Vec4{ { float(pixel[0]), float(pixel[1]), float(pixel[2]), float(pixel[3]) } };
+}
+
+inline void storePixel(Vec4 value, uint8_t* pixel) {
+    for (int k = 0; k < 4; ++k) {
+        pixel[k] = static_cast<uint8_t>(std::min(255.0f, std::max(0.0f, value.v[k])) + 0.5f);
+    }
+}
+
+#endif
+
+inline int clampIndex(int index, int count) {
+    return std::min(count - 1, std::max(0, index));
+}
+
+struct PassInfo {
+    int radius;
+    std::vector<Vec4> weights;      // Broadcast taps; empty for a box
+};
+
+// Running sum along a row: constant cost per pixel for any radius
+void boxRow(const Vec4* in, Vec4* out, int count, int radius) {
+    const Vec4 scale = splat(1.0f / (2 * radius + 1));
+    Vec4 sum = zero();
+    for (int k = -radius; k <= radius; ++k) {
+        sum = sum + in[clampIndex(k, count)];
+    }
+    for (int x = 0; x < count; ++x) {
+        out[x] = sum * scale;
+        sum = sum + in[std::min(x + radius + 1, count - 1)] - in[std::max(x - radius, 0)];
+    }
+}
+
+void kernelRow(const Vec4* in, Vec4* out, int count, int radius, const Vec4* weights) {
+    // Only the ends need clamping
+    const int interiorBegin = std::min(radius, count);
+    const int interiorEnd = std::max(interiorBegin, count - radius);
+    for (int x = 0; x < count; ++x) {
+        if (x == interiorBegin) {
+            for (; x < interiorEnd; ++x) {
+                const Vec4* taps = in + x - radius;
+                Vec4 sum = taps[0] * weights[0];
+                for (int k = 1; k <= 2 * radius; ++k) {
+                    sum = sum + taps[k] * weights[k];
+                }
+                out[x] = sum;
+            }
+            if (x == count) {
+                break;
+            }
+        }
+        Vec4 sum = zero();
+        for (int k = -radius; k <= radius; ++k) {
+            sum = sum + in[clampIndex(x + k, count)] * weights[k + radius];
+        }
+        out[x] = sum;
+    }
+}
+
+// The vertical passes run a row at a time over columns [begin, end), so
+// every access walks memory in order
+void boxColumns(const Vec4* in, Vec4* out, int stride, int rows, int begin, int end,
+                int radius, std::vector<Vec4>& sums) {
+    const Vec4 scale = splat(1.0f / (2 * radius + 1));
+    sums.assign(end - begin, zero());
+    for (int k = -radius; k <= radius; ++k) {
+        const Vec4* row = in + static_cast<size_t>(clampIndex(k, rows)) * stride;
+        for (int c = begin; c < end; ++c) {
+            sums[c - begin] = sums[c - begin] + row[c];
+        }
+    }
+    for (int y = 0; y < rows; ++y) {
+        Vec4* target = out + static_cast<size_t>(y) * stride;
+        const Vec4* entering = in + static_cast<size_t>(std::min(y + radius + 1, rows - 1)) * stride;
+        const Vec4* leaving = in + static_cast<size_t>(std::max(y - radius, 0)) * stride;
+        for (int c = begin; c < end; ++c) {
+            Vec4& sum = sums[c - begin];
+            target[c] = sum * scale;
+            sum = sum + entering[c] - leaving[c];
+        }
+    }
+}
+
+void kernelColumns(const Vec4* in, Vec4* out, int stride, int rows, int begin, int end,
+                   int radius, const Vec4* weights) {
+    for (int y = 0; y < rows; ++y) {
+        Vec4* target = out + static_cast<size_t>(y) * stride;
+        const Vec4* first = in + static_cast<size_t>(clampIndex(y - radius, rows)) * stride;
+        for (int c = begin; c < end; ++c) {
+            target[c] = first[c] * weights[0];
+        }
+        for (int k = 1; k <= 2 * radius; ++k) {
+            const Vec4* row = in + static_cast<size_t>(clampIndex(y - radius + k, rows)) * stride;
+            const Vec4 weight = weights[k];
+            for (int c = begin; c < end; ++c) {
+                target[c] = target[c] + row[c] * weight;
+            }
+        }
+    }
+}
+
+struct Scratch {
+    std::vector<Vec4> front;
+    std::vector<Vec4> back;
+    std::vector<Vec4> sums;
+    std::vector<int> columns;
+};
+
+// Filters one tile (in source coordinates) into its place in dest
+void filterTile(const std::vector<PassInfo>& passes, int halo,
+                const uint8_t* source, int sourcePitch, int width, int height,
+                const SDL_Rect& tile, const SDL_Rect& rect, uint8_t* dest, int destPitch) {
+    static thread_local Scratch scratch;
+
+    // Tile plus halo, with edge pixels repeated past the source edges
+    const int stride = tile.w + 2 * halo;
+    const int rows = tile.h + 2 * halo;
+    scratch.front.resize(static_cast<size_t>(stride) * rows);
+    scratch.back.resize(static_cast<size_t>(stride) * rows);
+    scratch.columns.resize(stride);
+    for (int x = 0; x < stride; ++x) {
+        scratch.columns[x] = clampIndex(tile.x - halo + x, width) * 4;
+    }
+    for (int y = 0; y < rows; ++y) {
+        const uint8_t* row = source + static_cast<size_t>(clampIndex(tile.y - halo + y, height)) * sourcePitch;
+        Vec4* out = scratch.front.data() + static_cast<size_t>(y) * stride;
+        for (int x = 0; x < stride; ++x) {
+            out[x] = loadPixel(row + scratch.columns[x]);
+        }
+    }
+
+    Vec4* in = scratch.front.data();
+    Vec4* out = scratch.back.data();
+
+    // Across every row, since later passes read the halo columns
+    for (const PassInfo& pass : passes) {
+        for (int y = 0; y < rows; ++y) {
+            const size_t offset = static_cast<size_t>(y) * stride;
+            if (pass.weights.empty()) {
+                boxRow(in + offset, out + offset, stride, pass.radius);
+            } else {
+                kernelRow(in + offset, out + offset, stride, pass.radius, pass.weights.data());
+            }
+        }
+        std::swap(in, out);
+    }
+
+    // Down only the tile's own columns
+    for (const PassInfo& pass : passes) {
+        if (pass.weights.empty()) {
+            boxColumns(in, out, stride, rows, halo, halo + tile.w, pass.radius, scratch.sums);
+        } else {
+            kernelColumns(in, out, stride, rows, halo, halo + tile.w, pass.radius, pass.weights.data());
+        }
+        std::swap(in, out);
+    }
+
+    for (int y = 0; y < tile.h; ++y) {
+        const Vec4* row = in + static_cast<size_t>(y + halo) * stride + halo;
+        uint8_t* target = dest + static_cast<size_t>(tile.y - rect.y + y) * destPitch + (tile.x - rect.x) * 4;
+        for (int x = 0; x < tile.w; ++x) {
+            storePixel(row[x], target + x * 4);
+        }
+    }
+}
+
+} // namespace
+
+namespace Filter {
+
+Blur Blur::box(int radius) {
+    Blur blur;
+    if (radius > 0) {
+        blur.m_passes.push_back(Pass{ radius, {} });
+    }
+    return blur;
+}
+
+Blur Blur::gaussian(float sigma) {
+    Blur blur;
+    if (sigma <= 0.0f) {
+        return blur;
+    }
+
+    if (sigma <= kKernelSigmaLimit) {
+        const int radius = static_cast<int>(std::ceil(sigma * 3.0f));
+        Pass pass{ radius, std::vector<float>(2 * radius + 1) };
+        float total = 0.0f;
+        for (int k = -radius; k <= radius; ++k) {
+            float weight = std::exp(-(k * k) / (2.0f * sigma * sigma));
+            pass.weights[k + radius] = weight;
+            total += weight;
+        }
+        for (float& weight : pass.weights) {
+            weight /= total;
+        }
+        blur.m_passes.push_back(std::move(pass));
+        return blur;
+    }
+
+    // Three boxes whose combined variance matches sigma: the first m have
+    // the lower odd width, the rest the next odd width up
+    const int boxes = 3;
+    const float ideal = std::sqrt(12.0f * sigma * sigma / boxes + 1.0f);
+    int lower = static_cast<int>(std::floor(ideal));
+    if (lower % 2 == 0) {
+        lower--;
+    }
+    const int upper = lower + 2;
+    const float lowerCount = (12.0f * sigma * sigma - boxes * lower * lower - 4.0f * boxes * lower - 3.0f * boxes)
+                             / (-4.0f * lower - 4.0f);
+    const int m = static_cast<int>(std::lround(lowerCount));
+    for (int i = 0; i < boxes; ++i) {
+        const int size = i < m ? lower : upper;
+        if (size > 1) {
+            blur.m_passes.push_back(Pass{ (size - 1) / 2, {} });
+        }
+    }
+    return blur;
+}
+
+int Blur::halo() const {
+    int total = 0;
+    for (const Pass& pass : m_passes) {
+        total += pass.radius;
+    }
+    return total;
+}
+
+void apply(const Blur& blur, const void* source, int sourcePitch, int width, int height,
+           const SDL_Rect& rect, void* dest, int destPitch) {
+    const uint8_t* sourceBytes = static_cast<const uint8_t*>(source);
+    uint8_t* destBytes = static_cast<uint8_t*>(dest);
+
+    if (blur.isEmpty()) {
+        for (int y = 0; y < rect.h; ++y) {
+            std::memcpy(destBytes + static_cast<size_t>(y) * destPitch,
+                        sourceBytes + static_cast<size_t>(rect.y + y) * sourcePitch + rect.x * 4,
+                        static_cast<size_t>(rect.w) * 4);
+        }
+        return;
+    }
+
+    std::vector<PassInfo> passes;
+    for (const Blur::Pass& pass : blur.m_passes) {
+        PassInfo info{ pass.radius, {} };
+        for (float weight : pass.weights) {
+            info.weights.push_back(splat(weight));
+        }
+        passes.push_back(std::move(info));
+    }
+    const int halo = blur.halo();
+
+    // Wide halos get bigger tiles so rereading them stays a small overhead
+    const int tileSize = std::max(kTileSize, 4 * halo);
+    const int tilesX = (rect.w + tileSize - 1) / tileSize;
+    const int tilesY = (rect.h + tileSize - 1) / tileSize;
+    ThreadPool::instance().parallelFor(tilesX * tilesY, 1, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            const int x = rect.x + (i % tilesX) * tileSize;
+            const int y = rect.y + (i / tilesX) * tileSize;
+            const SDL_Rect tile = {
+                x, y,
+                std::min(tileSize, rect.x + rect.w - x),
+                std::min(tileSize, rect.y + rect.h - y)
+            };
+            filterTile(passes, halo, sourceBytes, sourcePitch, width, height, tile, rect, destBytes, destPitch);
+        }
+    });
+}
+
+}
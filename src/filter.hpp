@@ -0,0 +1,45 @@
+// filter.hpp
+#pragma once
+#include <SDL2/SDL.h>
+#include <vector>
+
+// Image filters on CPU pixel buffers in any packed 32-bit format; all four
+// bytes of a pixel are filtered alike, so blur premultiplied pixels to keep
+// color from bleeding out of transparent areas. Work is split into tiles
+// run in parallel on the shared ThreadPool. Each tile reads a halo of
+// surrounding pixels, so tiles need nothing from each other.
+namespace Filter {
+
+    // A separable blur, as a list of 1D passes applied across then down
+    class Blur {
+    public:
+        // Mean of the (2 * radius + 1)^2 square around each pixel
+        static Blur box(int radius);
+
+        // Small sigmas use an exact kernel; larger ones three box passes,
+        // which stay constant time per pixel whatever the radius
+        static Blur gaussian(float sigma);
+
+        // Pixels on each side a result depends on
+        int halo() const;
+
+        bool isEmpty() const { return m_passes.empty(); }
+
+    private:
+        friend void apply(const Blur&, const void*, int, int, int, const SDL_Rect&, void*, int);
+
+        struct Pass {
+            int radius;
+            std::vector<float> weights;     // 2 * radius + 1 taps; empty for a box
+        };
+
+        std::vector<Pass> m_passes;
+    };
+
+    // Filters rect of a width x height source into dest, which holds just
+    // rect. Pixels around rect are read as context; beyond the source edges
+    // the edge pixels repeat. Pitches are in bytes.
+    void apply(const Blur& blur, const void* source, int sourcePitch, int width, int height,
+               const SDL_Rect& rect, void* dest, int destPitch);
+
+}
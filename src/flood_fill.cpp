@@ -0,0 +1,309 @@
+// flood_fill.cpp
+#include "flood_fill.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <cstdlib>
+
+namespace {
+
+struct Point {
+    int x;
+    int y;
+};
+
+// A seed one tile hands to another
+struct Handoff {
+    int tile;
+    Point point;
+};
+
+// What one tile's pass produced, kept per worker slot so tiles never share
+// anything while a round runs
+struct TileResult {
+    std::vector<Handoff> handoffs;
+    int left, top, right, bottom;       // Inclusive; right < left if nothing filled
+};
+
+class Grower {
+public:
+    Grower(int width, int height, int tolerance, uint32_t seedColor, FloodFill::Region& region)
+        : m_width(width), m_height(height)
+        , m_tolerance(tolerance), m_seedColor(seedColor), m_region(region)
+    {
+    }
+
+    // (x, y) must lie in a loaded tile
+    bool matches(int x, int y) const {
+        const int tile = (y / FloodFill::TileSize) * m_region.tilesX + x / FloodFill::TileSize;
+        const uint32_t pixel = m_region.pixels[tile][
+            static_cast<size_t>(y % FloodFill::TileSize) * FloodFill::TileSize + x % FloodFill::TileSize];
+        if (m_tolerance == 0) {
+            return pixel == m_seedColor;
+        }
+        for (int shift = 0; shift < 32; shift += 8) {
+            int difference = static_cast<int>((pixel >> shift) & 0xFF) - static_cast<int>((m_seedColor >> shift) & 0xFF);
+            if (std::abs(difference) > m_tolerance) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Fills what the seeds reach inside tile. Writes only that tile's mask
+    // pixels and touched flag.
+    void fillTile(int tile, std::vector<Point>& seeds, TileResult& result) {
+        const int tileX = tile % m_region.tilesX;
+        const int tileY = tile / m_region.tilesX;
+        const int x0 = tileX * FloodFill::TileSize;
+        const int y0 = tileY * FloodFill::TileSize;
+        const int x1 = std::min(m_width, x0 + FloodFill::TileSize);     // Exclusive
+        const int y1 = std::min(m_height, y0 + FloodFill::TileSize);
+
+        result.handoffs.clear();
+        result.left = x1;
+        result.top = y1;
+        result.right = x0 - 1;
+        result.bottom = y0 - 1;
+
+        // The mask is the tile's own, indexed from its corner
+        uint8_t* mask = m_region.masks[tile].data();
+        auto fillable = [&](int x, int y) {
+            return mask[static_cast<size_t>(y - y0) * FloodFill::TileSize + (x - x0)] == 0 && matches(x, y);
+        };
+
+        // Seeds for each run of matching pixels in [left, right] of row y,
+        // which may lie in another tile
+        auto seedRow = [&](int left, int right, int y) {
+            const bool inside = y >= y0 && y < y1;
+            const int neighbour = inside ? tile : (y < y0 ? tile - m_region.tilesX : tile + m_region.tilesX);
+            bool inRun = false;
+            for (int x = left; x <= right; ++x) {
+                bool open = inside ? fillable(x, y) : matches(x, y);
+                if (open && !inRun) {
+                    if (inside) {
+                        seeds.push_back(Point{ x, y });
+                    } else {
+                        result.handoffs.push_back(Handoff{ neighbour, Point{ x, y } });
+                    }
+                }
+                inRun = open;
+            }
+        };
+
+        while (!seeds.empty()) {
+            const Point seed = seeds.back();
+            seeds.pop_back();
+            if (!fillable(seed.x, seed.y)) {
+                continue;
+            }
+
+            // Widen the seed to the whole span within the tile
+            int left = seed.x;
+            int right = seed.x;
+            while (left > x0 && fillable(left - 1, seed.y)) {
+                --left;
+            }
+            while (right < x1 - 1 && fillable(right + 1, seed.y)) {
+                ++right;
+            }
+
+            uint8_t* row = mask + static_cast<size_t>(seed.y - y0) * FloodFill::TileSize - x0;
+            std::fill(row + left, row + right + 1, uint8_t(1));
+            result.left = std::min(result.left, left);
+            result.right = std::max(result.right, right);
+            result.top = std::min(result.top, seed.y);
+            result.bottom = std::max(result.bottom, seed.y);
+
+            // The span may continue into the tiles either side
+            if (left == x0 && x0 > 0 && matches(x0 - 1, seed.y)) {
+                result.handoffs.push_back(Handoff{ tile - 1, Point{ x0 - 1, seed.y } });
+            }
+            if (right == x1 - 1 && x1 < m_width && matches(x1, seed.y)) {
+                result.handoffs.push_back(Handoff{ tile + 1, Point{ x1, seed.y } });
+            }
+
+            if (seed.y > 0) {
+                seedRow(left, right, seed.y - 1);
+            }
+            if (seed.y < m_height - 1) {
+                seedRow(left, right, seed.y + 1);
+            }
+        }
+
+        if (result.right >= result.left) {
+            m_region.touched[tile] = 1;
+        }
+    }
+
+private:
+    int m_width;
+    int m_height;
+    int m_tolerance;
+    uint32_t m_seedColor;
+    FloodFill::Region& m_region;
+};
+
+} // namespace
+
+namespace FloodFill {
+
+SDL_Rect Region::tileRect(int tileX, int tileY, int width, int height) const {
+    const int x = tileX * TileSize;
+    const int y = tileY * TileSize;
+    return SDL_Rect{ x, y, std::min(TileSize, width - x), std::min(TileSize, height - y) };
+}
+
+bool grow(const TileReader& read, int width, int height,
+          int x, int y, int tolerance, Region& region) {
+    region.bounds = SDL_Rect{ 0, 0, 0, 0 };
+    if (x < 0 || y < 0 || x >= width || y >= height) {
+        return false;
+    }
+
+    region.tilesX = (width + TileSize - 1) / TileSize;
+    region.tilesY = (height + TileSize - 1) / TileSize;
+    const int tileCount = region.tilesX * region.tilesY;
+    region.touched.assign(tileCount, 0);
+    region.pixels.assign(tileCount, std::vector<uint32_t>());
+    region.masks.assign(tileCount, std::vector<uint8_t>());
+
+    // Reads the listed tiles that aren't loaded yet, one read per row of
+    // tiles spanning the ones needed in it
+    std::vector<uint8_t> wanted(tileCount, 0);
+    std::vector<uint32_t> strip;
+    auto load = [&](const std::vector<int>& tiles) {
+        bool any = false;
+        for (int tile : tiles) {
+            if (region.pixels[tile].empty()) {
+                wanted[tile] = 1;
+                any = true;
+            }
+        }
+        if (!any) {
+            return true;
+        }
+        for (int tileY = 0; tileY < region.tilesY; ++tileY) {
+            int first = region.tilesX;
+            int last = -1;
+            for (int tileX = 0; tileX < region.tilesX; ++tileX) {
+                if (wanted[tileY * region.tilesX + tileX]) {
+                    first = std::min(first, tileX);
+                    last = tileX;
+                }
+            }
+            if (last < first) {
+                continue;
+            }
+
+            const SDL_Rect firstRect = region.tileRect(first, tileY, width, height);
+            const SDL_Rect lastRect = region.tileRect(last, tileY, width, height);
+            const SDL_Rect rect = { firstRect.x, firstRect.y, lastRect.x + lastRect.w - firstRect.x, firstRect.h };
+            strip.resize(static_cast<size_t>(rect.w) * rect.h);
+            if (!read(rect, strip.data(), rect.w * 4)) {
+                return false;
+            }
+
+            for (int tileX = first; tileX <= last; ++tileX) {
+                const int tile = tileY * region.tilesX + tileX;
+                if (!wanted[tile]) {
+                    continue;
+                }
+                wanted[tile] = 0;
+                const SDL_Rect tileRect = region.tileRect(tileX, tileY, width, height);
+                std::vector<uint32_t>& pixels = region.pixels[tile];
+                pixels.resize(static_cast<size_t>(TileSize) * TileSize);
+                for (int row = 0; row < tileRect.h; ++row) {
+                    const uint32_t* source = strip.data() + static_cast<size_t>(row) * rect.w + (tileRect.x - rect.x);
+                    std::copy(source, source + tileRect.w, pixels.data() + static_cast<size_t>(row) * TileSize);
+                }
+            }
+        }
+        return true;
+    };
+
+    const int seedTile = (y / TileSize) * region.tilesX + x / TileSize;
+    if (!load(std::vector<int>{ seedTile })) {
+        return false;
+    }
+    const uint32_t seedColor = region.pixels[seedTile][
+        static_cast<size_t>(y % TileSize) * TileSize + x % TileSize];
+    Grower grower(width, height, std::max(0, tolerance), seedColor, region);
+
+    // Seeds waiting for each tile's next pass
+    std::vector<std::vector<Point>> pending(tileCount);
+    pending[(y / TileSize) * region.tilesX + x / TileSize].push_back(Point{ x, y });
+
+    std::vector<int> active;
+    std::vector<int> needed;
+    std::vector<std::vector<Point>> work;
+    std::vector<TileResult> results;
+    int left = width, top = height, right = -1, bottom = -1;
+
+    for (;;) {
+        active.clear();
+        for (int tile = 0; tile < tileCount; ++tile) {
+            if (!pending[tile].empty()) {
+                active.push_back(tile);
+            }
+        }
+        if (active.empty()) {
+            break;
+        }
+
+        // A tile's pass reads its own pixels and the edge rows and columns
+        // of the tiles beside it
+        needed.clear();
+        for (int tile : active) {
+            const int tileX = tile % region.tilesX;
+            const int tileY = tile / region.tilesX;
+            needed.push_back(tile);
+            if (tileX > 0) needed.push_back(tile - 1);
+            if (tileX < region.tilesX - 1) needed.push_back(tile + 1);
+            if (tileY > 0) needed.push_back(tile - region.tilesX);
+            if (tileY < region.tilesY - 1) needed.push_back(tile + region.tilesX);
+            if (region.masks[tile].empty()) {
+                region.masks[tile].assign(static_cast<size_t>(TileSize) * TileSize, 0);
+            }
+        }
+        if (!load(needed)) {
+            region.bounds = SDL_Rect{ 0, 0, 0, 0 };
+            return false;
+        }
+
+        // Each active tile owns its seeds for the round; results come back
+        // per slot and are merged once everything has finished
+        const int activeCount = static_cast<int>(active.size());
+        work.resize(std::max(work.size(), active.size()));
+        results.resize(std::max(results.size(), active.size()));
+        for (int i = 0; i < activeCount; ++i) {
+            work[i].swap(pending[active[i]]);
+            pending[active[i]].clear();
+        }
+
+        ThreadPool::instance().parallelFor(activeCount, 1, [&](int begin, int end) {
+            for (int i = begin; i < end; ++i) {
+                grower.fillTile(active[i], work[i], results[i]);
+            }
+        });
+
+        for (int i = 0; i < activeCount; ++i) {
+            const TileResult& result = results[i];
+            if (result.right >= result.left) {
+                left = std::min(left, result.left);
+                top = std::min(top, result.top);
+                right = std::max(right, result.right);
+                bottom = std::max(bottom, result.bottom);
+            }
+            for (const Handoff& handoff : result.handoffs) {
+                pending[handoff.tile].push_back(handoff.point);
+            }
+        }
+    }
+
+    if (right >= left) {
+        region.bounds = SDL_Rect{ left, top, right - left + 1, bottom - top + 1 };
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,49 @@
+// flood_fill.hpp
+#pragma once
+#include <SDL2/SDL.h>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Region growing for bucket fill. Works on packed 32-bit pixels in CPU
+// memory. The image is split into square tiles; each tile runs a span-based
+// scanline fill over its own pixels and hands seeds that cross its edges to
+// the neighbouring tile. Tiles with pending seeds are processed in rounds,
+// in parallel on the shared ThreadPool, so a region covering most of a
+// large canvas spreads across every core while a small one stays in a
+// single tile.
+//
+// Pixels are fetched a tile at a time as the fill reaches them, so a small
+// fill on a large image reads and allocates only the few tiles around it.
+namespace FloodFill {
+
+    const int TileSize = 256;
+
+    // Copies rect of the image into pixels (pitch in bytes). Called from
+    // the thread running grow(), never from the pool. Returns false on
+    // failure.
+    using TileReader = std::function<bool(const SDL_Rect& rect, uint32_t* pixels, int pitch)>;
+
+    struct Region {
+        SDL_Rect bounds = { 0, 0, 0, 0 };   // Empty if nothing was filled
+        int tilesX = 0;
+        int tilesY = 0;
+        std::vector<uint8_t> touched;       // One flag per tile, row by row
+
+        // Per tile, TileSize x TileSize with a pitch of TileSize. Empty for
+        // tiles the fill never read; touched tiles always have both. mask
+        // is 1 where filled.
+        std::vector<std::vector<uint32_t>> pixels;
+        std::vector<std::vector<uint8_t>> masks;
+
+        bool isTouched(int tileX, int tileY) const { return touched[tileY * tilesX + tileX] != 0; }
+        SDL_Rect tileRect(int tileX, int tileY, int width, int height) const;
+    };
+
+    // Finds the 4-connected region around (x, y) whose pixels differ from
+    // the seed pixel by at most tolerance on every byte. Returns false if
+    // (x, y) lies outside the image or a read failed.
+    bool grow(const TileReader& read, int width, int height,
+              int x, int y, int tolerance, Region& region);
+
+}
@@ -0,0 +1,201 @@
+// frame_arena.cpp
+#include "frame_arena.hpp"
+#include <algorithm>
+
+namespace {
+
+const size_t kMinBlockSize = 1024 * 1024;
+
+// Largest block kept between frames; bigger frames spill into blocks that
+// are freed again by reset()
+const size_t kMaxKeptBlockSize = 16 * 1024 * 1024;
+
+// Pooled items unused for this many frames are released
+const uint64_t kIdleFrames = 300;
+
+} // namespace
+
+FrameArena::FrameArena(SDL_Renderer* renderer, Uint32 format)
+    : m_renderer(renderer)
+    , m_format(format)
+{
+}
+
+FrameArena::~FrameArena() {
+    for (auto& pooled : m_surfaces) {
+        SDL_FreeSurface(pooled.item);
+    }
+    for (auto& pooled : m_targets) {
+        SDL_DestroyTexture(pooled.item);
+    }
+}
+
+void* FrameArena::allocate(size_t bytes, size_t alignment) {
+    for (;;) {
+        if (m_blockIndex < m_blocks.size()) {
+            Block& block = m_blocks[m_blockIndex];
+            uintptr_t base = reinterpret_cast<uintptr_t>(block.memory.get());
+            uintptr_t aligned = (base + m_blockOffset + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+            size_t end = static_cast<size_t>(aligned - base) + bytes;
+            if (end <= block.size) {
+                m_blockOffset = end;
+                m_stats.bytesUsed += bytes;
+                m_stats.bytesHighWater = std::max(m_stats.bytesHighWater, m_stats.bytesUsed);
+                return reinterpret_cast<void*>(aligned);
+            }
+            // Doesn't fit; move on to the next block
+            m_blockIndex++;
+            m_blockOffset = 0;
+            continue;
+        }
+
+        size_t size = std::max(kMinBlockSize, bytes + alignment);
+        m_blocks.push_back(Block{ std::unique_ptr<uint8_t[]>(new uint8_t[size]), size });
+        m_stats.allocations++;
+    }
+}
+
+SDL_Surface* FrameArena::surface(int width, int height) {
+    for (auto& pooled : m_surfaces) {
+        if (!pooled.inUse && pooled.width == width && pooled.height == height) {
+            pooled.inUse = true;
+            pooled.lastUsedFrame = m_frame;
+            m_stats.surfacesInUse++;
+            m_stats.surfacesHighWater = std::max(m_stats.surfacesHighWater, m_stats.surfacesInUse);
+            return pooled.item;
+        }
+    }
+
+    SDL_Surface* created = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, m_format);
+    if (!created) {
+        return nullptr;
+    }
+    // Scratch surfaces are copied into, never blended into
+    SDL_SetSurfaceBlendMode(created, SDL_BLENDMODE_NONE);
+    m_surfaces.push_back(Pooled<SDL_Surface>{ created, width, height, true, m_frame });
+    m_stats.allocations++;
+    m_stats.surfacesInUse++;
+    m_stats.surfacesHighWater = std::max(m_stats.surfacesHighWater, m_stats.surfacesInUse);
+    return created;
+}
+
+SDL_Texture* FrameArena::createTarget(int width, int height) {
+    SDL_Texture* created = SDL_CreateTexture(m_renderer, m_format, SDL_TEXTUREACCESS_TARGET, width, height);
+    if (created) {
+        m_stats.allocations++;
+    }
+    return created;
+}
+
+SDL_Texture* FrameArena::renderTarget(int width, int height) {
+    SDL_Texture* target = nullptr;
+    for (auto& pooled : m_targets) {
+        if (!pooled.inUse && pooled.width == width && pooled.height == height) {
+            pooled.inUse = true;
+            pooled.lastUsedFrame = m_frame;
+            target = pooled.item;
+            break;
+        }
+    }
+    if (!target) {
+        target = createTarget(width, height);
+        if (!target) {
+            return nullptr;
+        }
+        m_targets.push_back(Pooled<SDL_Texture>{ target, width, height, true, m_frame });
+    }
+
+    SDL_SetTextureBlendMode(target, SDL_BLENDMODE_BLEND);
+    m_stats.targetsInUse++;
+    m_stats.targetsHighWater = std::max(m_stats.targetsHighWater, m_stats.targetsInUse);
+    return target;
+}
+
+SDL_Texture* FrameArena::takeTarget(int width, int height) {
+    for (auto it = m_targets.begin(); it != m_targets.end(); ++it) {
+        if (!it->inUse && it->width == width && it->height == height) {
+            SDL_Texture* target = it->item;
+            m_targets.erase(it);
+            SDL_SetTextureBlendMode(target, SDL_BLENDMODE_BLEND);
+            return target;
+        }
+    }
+    SDL_Texture* target = createTarget(width, height);
+    if (target) {
+        SDL_SetTextureBlendMode(target, SDL_BLENDMODE_BLEND);
+    }
+    return target;
+}
+
+void FrameArena::adoptTarget(SDL_Texture* texture) {
+    if (!texture) {
+        return;
+    }
+    Uint32 format = 0;
+    int access = 0;
+    int width = 0;
+    int height = 0;
+    if (SDL_QueryTexture(texture, &format, &access, &width, &height) != 0
+        || format != m_format || access != SDL_TEXTUREACCESS_TARGET) {
+        SDL_DestroyTexture(texture);
+        return;
+    }
+    m_targets.push_back(Pooled<SDL_Texture>{ texture, width, height, false, m_frame });
+}
+
+void FrameArena::reset() {
+    if (m_stats.bytesUsed > kMinBlockSize) {
+        m_lastLargeFrame = m_frame;
+    }
+
+    // A frame that spilled into several blocks gets one block big enough
+    // for all of it, up to a cap, so the next frame like it fits without
+    // allocating
+    if (m_blocks.size() > 1) {
+        size_t total = 0;
+        for (const Block& block : m_blocks) {
+            total += block.size;
+        }
+        total = std::min(total, kMaxKeptBlockSize);
+        m_blocks.clear();
+        m_blocks.push_back(Block{ std::unique_ptr<uint8_t[]>(new uint8_t[total]), total });
+    }
+    m_blockIndex = 0;
+    m_blockOffset = 0;
+
+    for (auto& pooled : m_surfaces) {
+        pooled.inUse = false;
+    }
+    for (auto& pooled : m_targets) {
+        pooled.inUse = false;
+    }
+    trim();
+
+    m_frame++;
+    m_stats.bytesUsed = 0;
+    m_stats.surfacesInUse = 0;
+    m_stats.targetsInUse = 0;
+    m_stats.allocations = 0;
+}
+
+void FrameArena::trim() {
+    auto idle = [this](uint64_t lastUsedFrame) { return m_frame - lastUsedFrame > kIdleFrames; };
+
+    // A grown block goes once frames stop needing it, like pooled items;
+    // the next allocation starts a normal-sized one
+    if (!m_blocks.empty() && m_blocks.front().size > kMinBlockSize && idle(m_lastLargeFrame)) {
+        m_blocks.clear();
+    }
+
+    m_surfaces.erase(std::remove_if(m_surfaces.begin(), m_surfaces.end(), [&](const Pooled<SDL_Surface>& pooled) {
+        if (!idle(pooled.lastUsedFrame)) return false;
+        SDL_FreeSurface(pooled.item);
+        return true;
+    }), m_surfaces.end());
+
+    m_targets.erase(std::remove_if(m_targets.begin(), m_targets.end(), [&](const Pooled<SDL_Texture>& pooled) {
+        if (!idle(pooled.lastUsedFrame)) return false;
+        SDL_DestroyTexture(pooled.item);
+        return true;
+    }), m_targets.end());
+}
@@ -0,0 +1,85 @@
+// frame_arena.hpp
+#pragma once
+#include <SDL2/SDL.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Scratch memory, surfaces and render targets that live until the end of
+// the frame. Graphics owns one and resets it in render(); everything handed
+// out is reused by later frames, so a frame that needs the same scratch as
+// the one before makes no heap or driver allocations.
+//
+// Surfaces and targets are pooled by exact size in the renderer's native
+// format. Their contents are undefined when handed out. Pooled items that go
+// unused for a few seconds are released, and so is scratch memory beyond
+// the minimum block once frames stop needing it.
+class FrameArena {
+public:
+    struct Stats {
+        size_t bytesUsed = 0;           // Pixel buffer bytes handed out this frame
+        size_t bytesHighWater = 0;      // Most bytes any frame has used
+        int surfacesInUse = 0;
+        int surfacesHighWater = 0;
+        int targetsInUse = 0;
+        int targetsHighWater = 0;
+        int allocations = 0;            // Blocks, surfaces and targets created this frame
+    };
+
+    FrameArena(SDL_Renderer* renderer, Uint32 format);
+    ~FrameArena();
+
+    // Prevent copying
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    // Uninitialized memory valid until reset()
+    void* allocate(size_t bytes, size_t alignment = 16);
+
+    // Pooled surface or render target, returned to the pool by reset()
+    SDL_Surface* surface(int width, int height);
+    SDL_Texture* renderTarget(int width, int height);
+
+    // Hands a pooled render target over for good; the caller destroys it
+    // or gives it back with adoptTarget()
+    SDL_Texture* takeTarget(int width, int height);
+
+    // Adds a render target in the arena's format to the pool. Anything else
+    // is destroyed.
+    void adoptTarget(SDL_Texture* texture);
+
+    // Makes everything handed out this frame available again
+    void reset();
+
+    const Stats& getStats() const { return m_stats; }
+
+private:
+    struct Block {
+        std::unique_ptr<uint8_t[]> memory;
+        size_t size;
+    };
+
+    template <typename T>
+    struct Pooled {
+        T* item;
+        int width;
+        int height;
+        bool inUse;
+        uint64_t lastUsedFrame;
+    };
+
+    SDL_Texture* createTarget(int width, int height);
+    void trim();
+
+    SDL_Renderer* m_renderer;
+    Uint32 m_format;
+    std::vector<Block> m_blocks;
+    size_t m_blockIndex = 0;            // Block being bumped
+    size_t m_blockOffset = 0;
+    std::vector<Pooled<SDL_Surface>> m_surfaces;
+    std::vector<Pooled<SDL_Texture>> m_targets;
+    uint64_t m_frame = 0;
+    uint64_t m_lastLargeFrame = 0;      // Last frame that used more than a minimum block
+    Stats m_stats;
+};
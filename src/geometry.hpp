@@ -0,0 +1,66 @@
+// geometry.hpp
+#pragma once
+#include <algorithm>
+#include <cstddef>
+
+struct Vec2f {
+    float x = 0.0f;
+    float y = 0.0f;
+};
+
+// 2D affine transform: x' = a*x + c*y + tx, y' = b*x + d*y + ty
+struct Transform2D {
+    float a = 1.0f, b = 0.0f;
+    float c = 0.0f, d = 1.0f;
+    float tx = 0.0f, ty = 0.0f;
+
+    Vec2f apply(float x, float y) const {
+        return Vec2f{ a * x + c * y + tx, b * x + d * y + ty };
+    }
+
+    Transform2D inverse() const {
+        float det = a * d - b * c;
+        float invDet = det != 0.0f ? 1.0f / det : 0.0f;
+        Transform2D result;
+        result.a = d * invDet;
+        result.b = -b * invDet;
+        result.c = -c * invDet;
+        result.d = a * invDet;
+        result.tx = -(result.a * tx + result.c * ty);
+        result.ty = -(result.b * tx + result.d * ty);
+        return result;
+    }
+};
+
+// Axis-aligned rectangle in world or screen space
+struct Rectangle {
+    float x = 0.0f;
+    float y = 0.0f;
+    float width = 0.0f;
+    float height = 0.0f;
+
+    float right() const { return x + width; }
+    float bottom() const { return y + height; }
+    bool isEmpty() const { return width <= 0.0f || height <= 0.0f; }
+
+    bool contains(float px, float py) const {
+        return px >= x && px < right() && py >= y && py < bottom();
+    }
+
+    bool intersects(const Rectangle& other) const {
+        return x < other.right() && other.x < right()
+            && y < other.bottom() && other.y < bottom();
+    }
+
+    // Overlapping area, or an empty rectangle if there is none
+    Rectangle intersection(const Rectangle& other) const {
+        float left = std::max(x, other.x);
+        float top = std::max(y, other.y);
+        float r = std::min(right(), other.right());
+        float b = std::min(bottom(), other.bottom());
+        if (r <= left || b <= top) {
+            return Rectangle{};
+        }
+        return Rectangle{ left, top, r - left, b - top };
+    }
+};
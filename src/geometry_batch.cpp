@@ -0,0 +1,59 @@
+// geometry_batch.cpp
+#include "geometry_batch.hpp"
+
+GeometryBatch::GeometryBatch(SDL_Renderer* renderer)
+    : m_renderer(renderer)
+{
+}
+
+void GeometryBatch::addQuad(SDL_Texture* target, SDL_Texture* texture, SDL_BlendMode blendMode,
+                            const Vec2f corners[4], const SDL_FRect& uv, SDL_Color color) {
+    if (!m_vertices.empty()
+        && (target != m_target || texture != m_texture || blendMode != m_blendMode)) {
+        flush();
+    }
+    m_target = target;
+    m_texture = texture;
+    m_blendMode = blendMode;
+
+    const SDL_FPoint texCoords[4] = {
+        { uv.x, uv.y },
+        { uv.x + uv.w, uv.y },
+        { uv.x + uv.w, uv.y + uv.h },
+        { uv.x, uv.y + uv.h }
+    };
+
+    const int base = static_cast<int>(m_vertices.size());
+    for (int i = 0; i < 4; ++i) {
+        m_vertices.push_back(SDL_Vertex{ SDL_FPoint{ corners[i].x, corners[i].y }, color, texCoords[i] });
+    }
+    const int quad[6] = { 0, 1, 2, 0, 2, 3 };
+    for (int index : quad) {
+        m_indices.push_back(base + index);
+    }
+    m_quads++;
+}
+
+void GeometryBatch::flush() {
+    if (m_vertices.empty()) {
+        return;
+    }
+
+    SDL_Texture* previousTarget = SDL_GetRenderTarget(m_renderer);
+    SDL_SetRenderTarget(m_renderer, m_target);
+
+    SDL_BlendMode previousBlendMode;
+    SDL_GetTextureBlendMode(m_texture, &previousBlendMode);
+    SDL_SetTextureBlendMode(m_texture, m_blendMode);
+
+    SDL_RenderGeometry(m_renderer, m_texture,
+                       m_vertices.data(), static_cast<int>(m_vertices.size()),
+                       m_indices.data(), static_cast<int>(m_indices.size()));
+
+    SDL_SetTextureBlendMode(m_texture, previousBlendMode);
+    SDL_SetRenderTarget(m_renderer, previousTarget);
+
+    m_vertices.clear();
+    m_indices.clear();
+    m_submissions++;
+}
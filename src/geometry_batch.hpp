@@ -0,0 +1,45 @@
+// geometry_batch.hpp
+#pragma once
+#include <SDL2/SDL.h>
+#include <vector>
+#include "geometry.hpp"
+
+// Collects textured quads and submits consecutive quads that share a render
+// target, texture and blend mode as one SDL_RenderGeometry call. Graphics
+// owns the batch; anything that draws through SDL directly must flush it
+// first so draw order is kept.
+class GeometryBatch {
+public:
+    explicit GeometryBatch(SDL_Renderer* renderer);
+
+    // Prevent copying
+    GeometryBatch(const GeometryBatch&) = delete;
+    GeometryBatch& operator=(const GeometryBatch&) = delete;
+
+    // Queues a quad. Corners are top-left, top-right, bottom-right,
+    // bottom-left of the source region; uv is that region in 0..1 texture
+    // coordinates. target is the render target at the time of the call
+    // (nullptr for the screen).
+    void addQuad(SDL_Texture* target, SDL_Texture* texture, SDL_BlendMode blendMode,
+                 const Vec2f corners[4], const SDL_FRect& uv, SDL_Color color);
+
+    // Submits everything queued
+    void flush();
+
+    bool isEmpty() const { return m_vertices.empty(); }
+
+    // Totals since the last resetCounters()
+    int getSubmissions() const { return m_submissions; }
+    int getQuads() const { return m_quads; }
+    void resetCounters() { m_submissions = 0; m_quads = 0; }
+
+private:
+    SDL_Renderer* m_renderer;
+    SDL_Texture* m_target = nullptr;
+    SDL_Texture* m_texture = nullptr;
+    SDL_BlendMode m_blendMode = SDL_BLENDMODE_BLEND;
+    std::vector<SDL_Vertex> m_vertices;
+    std::vector<int> m_indices;
+    int m_submissions = 0;
+    int m_quads = 0;
+};
@@ -1,5 +1,7 @@
 // graphics.cpp
 #include "graphics.hpp"
+#include "geometry_batch.hpp"
+#include "frame_arena.hpp"
 #include <SDL2/SDL_image.h>
 #include <stdexcept>
 #include <iostream>
@@ -43,9 +45,48 @@ Graphics::Graphics(int width, int height, const std::string& title)
         SDL_Quit();
         throw std::runtime_error("Renderer creation failed: " + std::string(SDL_GetError()));
     }
+
+    queryCapabilities();
+    m_batch = std::make_unique<GeometryBatch>(m_renderer);
+    m_arena = std::make_unique<FrameArena>(m_renderer, m_capabilities.nativeFormat);
+}
+
+void Graphics::queryCapabilities() {
+    SDL_RendererInfo info;
+    if (SDL_GetRendererInfo(m_renderer, &info) != 0) {
+        throw std::runtime_error("Failed to query renderer: " + std::string(SDL_GetError()));
+    }
+
+    m_capabilities.name = info.name ? info.name : "";
+    m_capabilities.textureFormats.assign(info.texture_formats, info.texture_formats + info.num_texture_formats);
+    m_capabilities.maxTextureWidth = info.max_texture_width;
+    m_capabilities.maxTextureHeight = info.max_texture_height;
+    m_capabilities.supportsTargets = (info.flags & SDL_RENDERER_TARGETTEXTURE) != 0;
+
+    // The renderer lists its formats in order of preference; take the first
+    // packed 32-bit one with an alpha channel
+    m_capabilities.nativeFormat = SDL_PIXELFORMAT_RGBA8888;
+    for (Uint32 format : m_capabilities.textureFormats) {
+        if (!SDL_ISPIXELFORMAT_FOURCC(format) && !SDL_ISPIXELFORMAT_INDEXED(format)
+            && SDL_BYTESPERPIXEL(format) == 4 && SDL_ISPIXELFORMAT_ALPHA(format)) {
+            m_capabilities.nativeFormat = format;
+            break;
+        }
+    }
+}
+
+bool Graphics::supportsFormat(Uint32 format) const {
+    for (Uint32 supported : m_capabilities.textureFormats) {
+        if (supported == format) {
+            return true;
+        }
+    }
+    return false;
 }
 
 Graphics::~Graphics() {
+    m_batch.reset();
+    m_arena.reset();
     if (m_renderer) {
         SDL_DestroyRenderer(m_renderer);
     }
@@ -56,13 +97,29 @@ Graphics::~Graphics() {
     SDL_Quit();
 }
 
+void Graphics::flushBatch() {
+    m_batch->flush();
+}
+
 void Graphics::clear() {
+    flushBatch();
     SDL_SetRenderDrawColor(m_renderer, 0, 0, 0, 255);
     SDL_RenderClear(m_renderer);
 }
 
 void Graphics::render() {
+    flushBatch();
     SDL_RenderPresent(m_renderer);
+
+    m_frameStats.geometrySubmissions = m_batch->getSubmissions();
+    m_frameStats.geometryQuads = m_batch->getQuads();
+    m_batch->resetCounters();
+
+    m_frameStats.arenaAllocations = m_arena->getStats().allocations;
+    m_arena->reset();
+
+    m_lastFrameStats = m_frameStats;
+    m_frameStats = FrameStats();
 }
 
 bool Graphics::pollEvent(Event& event) {
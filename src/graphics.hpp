@@ -3,8 +3,11 @@
 #include <SDL2/SDL.h>
 #include <string>
 #include <memory>
+#include <vector>
 
 class Texture;  // Forward declaration
+class GeometryBatch;
+class FrameArena;
 
 class Graphics {
 public:
@@ -44,11 +47,65 @@ public:
     void drawRectangle(int x, int y, int width, int height);
     void render();
 
+    // Renderer capabilities, queried once at startup
+    struct Capabilities {
+        std::string name;
+        std::vector<Uint32> textureFormats;
+        int maxTextureWidth;        // 0 means no limit reported
+        int maxTextureHeight;
+        bool supportsTargets;
+        Uint32 nativeFormat;        // Preferred 32-bit format with alpha
+    };
+
+    const Capabilities& getCapabilities() const { return m_capabilities; }
+    Uint32 getNativeFormat() const { return m_capabilities.nativeFormat; }
+    bool supportsFormat(Uint32 format) const;
+
+    // Per-frame counters, reset by render()
+    struct FrameStats {
+        int formatConversions = 0;  // Pixel format conversions on upload, readback or save
+        int drawsIssued = 0;        // Screen draws sent to SDL
+        int drawsCulled = 0;        // Screen draws skipped because they were off screen
+        int geometrySubmissions = 0;    // SDL_RenderGeometry calls made by the batch
+        int geometryQuads = 0;          // Quads those calls carried
+        int arenaAllocations = 0;       // Blocks, surfaces and targets the frame arena had to create
+    };
+
+    // Counters of the last presented frame
+    const FrameStats& getFrameStats() const { return m_lastFrameStats; }
+
+    // Counters of the frame being built
+    FrameStats& frameStats() { return m_frameStats; }
+
+    // Quads queued for SDL_RenderGeometry. Call flushBatch() before drawing
+    // through SDL directly so queued quads keep their place in draw order.
+    GeometryBatch& batch() { return *m_batch; }
+    void flushBatch();
+
+    // Scratch surfaces, buffers and targets that live until render()
+    FrameArena& frameArena() { return *m_arena; }
+
+    // Premultiplied alpha. Textures created while this is on keep color
+    // already multiplied by alpha: images are premultiplied once when loaded,
+    // every BlendMode uses its premultiplied equivalent, and saving converts
+    // back to straight alpha. Textures keep the mode they were created in,
+    // so set this once at startup rather than mixing the two.
+    void setPremultipliedAlpha(bool enabled) { m_premultipliedAlpha = enabled; }
+    bool usesPremultipliedAlpha() const { return m_premultipliedAlpha; }
+
     // For Texture's use
     SDL_Renderer* getRenderer() const { return m_renderer; }
 
 private:
+    void queryCapabilities();
+
     SDL_Window* m_window;
     SDL_Renderer* m_renderer;
+    std::unique_ptr<GeometryBatch> m_batch;
+    std::unique_ptr<FrameArena> m_arena;
+    Capabilities m_capabilities;
+    FrameStats m_frameStats;
+    FrameStats m_lastFrameStats;
+    bool m_premultipliedAlpha = false;
     friend class Texture;  // Allow Texture to access private members if needed
 };
\ No newline at end of file
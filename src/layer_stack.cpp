@@ -0,0 +1,269 @@
+// layer_stack.cpp
+#include "layer_stack.hpp"
+#include "graphics.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+LayerStack::LayerStack(Graphics& graphics, int width, int height)
+    : m_graphics(graphics)
+    , m_width(width)
+    , m_height(height)
+    , m_premultiplied(graphics.usesPremultipliedAlpha())
+{
+    m_composite = std::make_unique<Texture>(Texture::create(graphics, width, height));
+    m_composite->clear(0, 0, 0, 0);
+    m_empty = std::make_unique<Texture>(Texture::create(graphics, width, height));
+    m_empty->clear(0, 0, 0, 0);
+}
+
+LayerStack::~LayerStack() = default;
+
+LayerStack::Layer& LayerStack::at(int index) {
+    if (index < 0 || index >= getLayerCount()) {
+        throw std::runtime_error("Layer index out of range: " + std::to_string(index));
+    }
+    return *m_layers[index];
+}
+
+const LayerStack::Layer& LayerStack::at(int index) const {
+    if (index < 0 || index >= getLayerCount()) {
+        throw std::runtime_error("Layer index out of range: " + std::to_string(index));
+    }
+    return *m_layers[index];
+}
+
+int LayerStack::addLayer(const std::string& name) {
+    auto layer = std::make_unique<Layer>();
+    layer->name = name;
+    layer->texture = std::make_unique<Texture>(Texture::create(m_graphics, m_width, m_height));
+    layer->texture->clear(0, 0, 0, 0);
+    layer->revision = m_nextRevision++;
+
+    // A transparent layer changes nothing until something is drawn into it
+    m_layers.push_back(std::move(layer));
+    return getLayerCount() - 1;
+}
+
+void LayerStack::removeLayer(int index) {
+    at(index);
+    m_layers.erase(m_layers.begin() + index);
+    m_structureDirty = SDL_Rect{ 0, 0, m_width, m_height };
+}
+
+void LayerStack::moveLayer(int from, int to) {
+    at(from);
+    at(to);
+    if (from == to) {
+        return;
+    }
+    std::unique_ptr<Layer> layer = std::move(m_layers[from]);
+    m_layers.erase(m_layers.begin() + from);
+    m_layers.insert(m_layers.begin() + to, std::move(layer));
+    m_structureDirty = SDL_Rect{ 0, 0, m_width, m_height };
+}
+
+Texture& LayerStack::getLayer(int index) {
+    return *at(index).texture;
+}
+
+const std::string& LayerStack::getName(int index) const {
+    return at(index).name;
+}
+
+void LayerStack::touch(Layer& layer, const SDL_Rect& area) {
+    const SDL_Rect full = { 0, 0, m_width, m_height };
+    SDL_Rect clipped;
+    if (!SDL_IntersectRect(&area, &full, &clipped)) {
+        return;
+    }
+    layer.revision = m_nextRevision++;
+    SDL_UnionRect(&layer.dirty, &clipped, &layer.dirty);
+}
+
+void LayerStack::markDirty(int index, const SDL_Rect& area) {
+    touch(at(index), area);
+}
+
+void LayerStack::markAllDirty() {
+    for (auto& layer : m_layers) {
+        touch(*layer, SDL_Rect{ 0, 0, m_width, m_height });
+    }
+}
+
+void LayerStack::setBlendMode(int index, BlendMode mode) {
+    Layer& layer = at(index);
+    if (layer.blendMode != mode) {
+        layer.blendMode = mode;
+        touch(layer, SDL_Rect{ 0, 0, m_width, m_height });
+    }
+}
+
+void LayerStack::setOpacity(int index, float opacity) {
+    Layer& layer = at(index);
+    opacity = std::min(1.0f, std::max(0.0f, opacity));
+    if (layer.opacity != opacity) {
+        layer.opacity = opacity;
+        touch(layer, SDL_Rect{ 0, 0, m_width, m_height });
+    }
+}
+
+void LayerStack::setVisible(int index, bool visible) {
+    Layer& layer = at(index);
+    if (layer.visible != visible) {
+        layer.visible = visible;
+        touch(layer, SDL_Rect{ 0, 0, m_width, m_height });
+    }
+}
+
+BlendMode LayerStack::getBlendMode(int index) const {
+    return at(index).blendMode;
+}
+
+float LayerStack::getOpacity(int index) const {
+    return at(index).opacity;
+}
+
+bool LayerStack::isVisible(int index) const {
+    return at(index).visible;
+}
+
+bool LayerStack::canGroup(int begin, int end) const {
+    if (!m_premultiplied) {
+        return false;
+    }
+    int visible = 0;
+    for (int i = begin; i < end; ++i) {
+        const Layer& layer = *m_layers[i];
+        if (!layer.visible) {
+            continue;
+        }
+        if (layer.blendMode != BlendMode::Alpha) {
+            return false;
+        }
+        visible++;
+    }
+    return visible > 1;
+}
+
+Texture& LayerStack::cachedGroup(int begin, int end) {
+    std::vector<uint64_t> revisions;
+    for (int i = begin; i < end; ++i) {
+        revisions.push_back(m_layers[i]->revision);
+    }
+
+    // Reuse a matching group, or at least the texture of one over the same range
+    Group* group = nullptr;
+    for (Group& candidate : m_groups) {
+        if (candidate.begin == begin && candidate.end == end) {
+            group = &candidate;
+            break;
+        }
+    }
+    if (group && group->revisions == revisions) {
+        group->used = true;
+        return *group->texture;
+    }
+    if (!group) {
+        m_groups.push_back(Group{ begin, end, {}, nullptr, false });
+        group = &m_groups.back();
+        group->texture = std::make_unique<Texture>(Texture::create(m_graphics, m_width, m_height));
+    }
+
+    group->texture->clear(0, 0, 0, 0);
+    for (int i = begin; i < end; ++i) {
+        const Layer& layer = *m_layers[i];
+        if (layer.visible) {
+            DrawParams params;
+            params.blendMode = layer.blendMode;
+            params.opacity = layer.opacity;
+            layer.texture->render(*group->texture, 0, 0, params);
+        }
+    }
+    group->revisions = std::move(revisions);
+    group->used = true;
+    m_stats.groupsBuilt++;
+    return *group->texture;
+}
+
+void LayerStack::drawRegion(Texture& source, const SDL_Rect& area, const DrawParams& params) {
+    source.render(*m_composite, area.x, area.y, area.w, area.h, area.x, area.y, params);
+    m_stats.itemsDrawn++;
+}
+
+Texture& LayerStack::composite() {
+    const int count = getLayerCount();
+
+    // Everything that changed, and the lowest layer that did
+    SDL_Rect area = m_structureDirty;
+    int lowest = SDL_RectEmpty(&m_structureDirty) ? -1 : count;
+    for (int i = 0; i < count; ++i) {
+        const Layer& layer = *m_layers[i];
+        if (!SDL_RectEmpty(&layer.dirty)) {
+            SDL_UnionRect(&area, &layer.dirty, &area);
+            if (lowest < 0 || i < lowest) {
+                lowest = i;
+            }
+        }
+    }
+    if (SDL_RectEmpty(&area)) {
+        return *m_composite;
+    }
+
+    m_stats.itemsDrawn = 0;
+    for (Group& group : m_groups) {
+        group.used = false;
+    }
+
+    // Start from everything below the lowest changed layer
+    DrawParams copy;
+    copy.blendMode = BlendMode::None;
+    drawRegion(lowest > 0 ? cachedGroup(0, lowest) : *m_empty, area, copy);
+
+    // Then the changed layers, with the unchanged runs between them
+    for (int i = lowest; i < count;) {
+        if (!SDL_RectEmpty(&m_layers[i]->dirty)) {
+            const Layer& layer = *m_layers[i];
+            if (layer.visible) {
+                DrawParams params;
+                params.blendMode = layer.blendMode;
+                params.opacity = layer.opacity;
+                drawRegion(*layer.texture, area, params);
+            }
+            i++;
+            continue;
+        }
+
+        int end = i;
+        while (end < count && SDL_RectEmpty(&m_layers[end]->dirty)) {
+            end++;
+        }
+        if (canGroup(i, end)) {
+            drawRegion(cachedGroup(i, end), area, DrawParams());
+        } else {
+            for (int k = i; k < end; ++k) {
+                const Layer& layer = *m_layers[k];
+                if (layer.visible) {
+                    DrawParams params;
+                    params.blendMode = layer.blendMode;
+                    params.opacity = layer.opacity;
+                    drawRegion(*layer.texture, area, params);
+                }
+            }
+        }
+        i = end;
+    }
+
+    for (auto& layer : m_layers) {
+        layer->dirty = SDL_Rect{ 0, 0, 0, 0 };
+    }
+    m_structureDirty = SDL_Rect{ 0, 0, 0, 0 };
+
+    // Groups this composite didn't need are stale; their layers have moved on
+    m_groups.erase(std::remove_if(m_groups.begin(), m_groups.end(),
+                                  [](const Group& group) { return !group.used; }),
+                   m_groups.end());
+
+    m_stats.composites++;
+    m_stats.pixelsComposited = static_cast<long>(area.w) * area.h;
+    return *m_composite;
+}
@@ -0,0 +1,106 @@
+// layer_stack.hpp
+#pragma once
+#include <SDL2/SDL.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "texture.hpp"
+
+class Graphics;
+
+// Ordered paint layers, bottom first, flattened into one composite texture.
+// The composite is kept between frames and only the union of the areas
+// marked dirty since the last composite() is redrawn.
+//
+// Redrawing uses cached intermediates: everything below the lowest dirty
+// layer is one flattened texture, and each run of unchanged layers above it
+// is another, so painting on one layer costs the same however many layers
+// there are. A cache is rebuilt only when one of its layers changes. Runs
+// above the base are cached only when the textures are premultiplied and
+// every layer in the run blends with Alpha, the case where grouping gives
+// the same result; other runs are drawn layer by layer.
+class LayerStack {
+public:
+    struct Stats {
+        int composites = 0;         // Calls that redrew something
+        long pixelsComposited = 0;  // Area redrawn by the last composite
+        int itemsDrawn = 0;         // Layers and cached groups drawn by the last composite
+        int groupsBuilt = 0;        // Cached groups flattened, in total
+    };
+
+    LayerStack(Graphics& graphics, int width, int height);
+    ~LayerStack();
+
+    // Prevent copying
+    LayerStack(const LayerStack&) = delete;
+    LayerStack& operator=(const LayerStack&) = delete;
+
+    // Adds a transparent layer on top and returns its index
+    int addLayer(const std::string& name);
+    void removeLayer(int index);
+    void moveLayer(int from, int to);
+
+    int getLayerCount() const { return static_cast<int>(m_layers.size()); }
+    int getWidth() const { return m_width; }
+    int getHeight() const { return m_height; }
+
+    // Draw into a layer's texture, then say where with markDirty()
+    Texture& getLayer(int index);
+    const std::string& getName(int index) const;
+
+    void markDirty(int index, const SDL_Rect& area);
+    void markAllDirty();
+
+    // Property changes redraw the whole composite
+    void setBlendMode(int index, BlendMode mode);
+    void setOpacity(int index, float opacity);
+    void setVisible(int index, bool visible);
+    BlendMode getBlendMode(int index) const;
+    float getOpacity(int index) const;
+    bool isVisible(int index) const;
+
+    // Brings the flattened result up to date and returns it
+    Texture& composite();
+
+    const Stats& getStats() const { return m_stats; }
+
+private:
+    struct Layer {
+        std::string name;
+        std::unique_ptr<Texture> texture;
+        BlendMode blendMode = BlendMode::Alpha;
+        float opacity = 1.0f;
+        bool visible = true;
+        uint64_t revision = 0;          // Unique across the stack; changes with the content
+        SDL_Rect dirty = { 0, 0, 0, 0 };
+    };
+
+    // A flattened run of layers, valid while their revisions match
+    struct Group {
+        int begin;
+        int end;                        // Exclusive
+        std::vector<uint64_t> revisions;
+        std::unique_ptr<Texture> texture;
+        bool used;
+    };
+
+    Layer& at(int index);
+    const Layer& at(int index) const;
+    void touch(Layer& layer, const SDL_Rect& area);
+    bool canGroup(int begin, int end) const;
+    Texture& cachedGroup(int begin, int end);
+    void drawRegion(Texture& source, const SDL_Rect& area, const DrawParams& params);
+
+    Graphics& m_graphics;
+    int m_width;
+    int m_height;
+    bool m_premultiplied;
+    std::vector<std::unique_ptr<Layer>> m_layers;
+    std::vector<Group> m_groups;
+    std::unique_ptr<Texture> m_composite;
+    std::unique_ptr<Texture> m_empty;       // Base when no layer lies below the dirty ones
+    SDL_Rect m_structureDirty = { 0, 0, 0, 0 };    // Added, removed or moved layers
+    uint64_t m_nextRevision = 1;
+    Stats m_stats;
+};
@@ -1,6 +1,11 @@
 // C:\Code\GameDev\muffinGL\src\main.cpp
 #include "graphics.hpp"
 #include "texture.hpp"
+#include "render_graph.hpp"
+#include "decoded_cache.hpp"
+#include "autosave.hpp"
+#include "brush_mask_cache.hpp"
+#include "stroke_buffer.hpp"
 #include <iostream>
 #include <cmath>
 
@@ -10,21 +15,104 @@ int main(int argc, char* argv[]) {
     try {
         Graphics graphics(600, 400, "MuffinGL Mask Test");
         
+        // Decoded pixels are cached between runs so startup skips PNG decoding
+        DecodedCache decodedCache("cache/decoded");
+
         // Load and resize textures to 200x200
-        auto grassTexture = Texture::create(graphics, "resources/grass.png");
-        auto maskTexture = Texture::create(graphics, "resources/mask_white.png");
-        auto dirtTexture = Texture::create(graphics, "resources/dirt.png", true);
-        auto compositeBrushLayer = Texture::create(graphics, 100, 100);
+        auto grassTexture = Texture::create(graphics, "resources/grass.png", decodedCache);
+        auto dirtTexture = Texture::create(graphics, "resources/dirt.png", decodedCache, true);
 
         // maskTexture.save("resources/loaded_mask.png");
 
         dirtTexture.resize(1024, 1024);
         grassTexture.resize(BRUSH_SIZE, BRUSH_SIZE);
-        maskTexture.resize(BRUSH_SIZE, BRUSH_SIZE);
+
+        // The brush mask is generated at the brush size rather than resized
+        BrushMaskCache brushMasks(graphics);
+        BrushMaskCache::Shape brushShape;
+        brushShape.size = BRUSH_SIZE;
+        std::shared_ptr<Texture> brushMask = brushMasks.get(brushShape);
+        Texture& maskTexture = *brushMask;
         
         // maskTexture.save("resources/resized_mask.png");        
         
+        float x = 0.0f;
+        float y = 0.0f;
         float time = 0.0f;
+
+        // Each circle the brush travels is one stroke, blended into the
+        // dirt once when the circle completes
+        StrokeBuffer stroke(graphics, dirtTexture);
+        float strokeStart = 0.0f;
+        const float strokeLength = 2.0f * 3.14159265f;
+
+        // Compositing pipeline: brush layer -> dirt -> screen
+        RenderGraph graph(graphics);
+        auto grass = graph.import(grassTexture, "grass");
+        auto mask = graph.import(maskTexture, "mask");
+        auto dirt = graph.import(dirtTexture, "dirt");
+        auto brushLayer = graph.createTransient("brush layer", BRUSH_SIZE, BRUSH_SIZE);
+
+        graph.addPass("compose brush", { grass, mask }, { brushLayer },
+            [&](RenderGraph::PassContext& context) {
+                Texture& layer = context.texture(brushLayer);
+                layer.clear(0, 0, 0, 0);
+
+                // Draw the brush texture to the composite layer
+                grassTexture.render(
+                    layer,
+                    x,          // Texture source position x
+                    y,          // Texture source position y
+                    BRUSH_SIZE, // Texture source width
+                    BRUSH_SIZE, // Texture source height
+                    0,          // Local space x
+                    0,          // Local space y
+                    BlendMode::None  // No blending for initial composition
+                );
+
+                // Apply the mask to the composite layer
+                layer.applyMask(maskTexture);
+
+                // save the composed brush to a file
+                // layer.save("resources/composite.png");
+            });
+
+        graph.addPass("stamp brush", { brushLayer }, { dirt },
+            [&](RenderGraph::PassContext& context) {
+                if (!stroke.isActive()) {
+                    stroke.begin(1.0f, BlendMode::AlphaPreserve);
+                }
+
+                // Accumulate the composed brush into the stroke
+                StampPlacement placement;
+                placement.x = x;
+                placement.y = y;
+                placement.pivotX = 0.0f;
+                placement.pivotY = 0.0f;
+                stroke.stamp(context.texture(brushLayer), placement);
+
+                // Finish the stroke into the dirt texture
+                if (time - strokeStart >= strokeLength) {
+                    stroke.end();
+                    strokeStart = time;
+                }
+            });
+
+        graph.addPass("present", { dirt }, { RenderGraph::Backbuffer },
+            [&](RenderGraph::PassContext&) {
+                graphics.clear();
+
+                // Draw dirt background with composed brush baked into it to the screen
+                float screen_x = 50.0;
+                float screen_y = 50.0;
+
+                dirtTexture.render(screen_x, screen_y, nullptr);
+                stroke.renderPreview(static_cast<int>(screen_x), static_cast<int>(screen_y));
+            });
+
+        // The dirt texture is the canvas the brush paints into
+        AutosaveService autosave(graphics, dirtTexture, "autosave.qoi");
+
         bool running = true;
         
         while (running) {
@@ -38,44 +126,11 @@ int main(int argc, char* argv[]) {
             
             // Calculate position for final placement
             time += 0.016f;
-            float x = (std::cos(time) * 50.0f) + 50.0f;
-            float y = (std::sin(time) * 50.0f) + 50.0f;
-            
-            graphics.clear();
-            
-            compositeBrushLayer.clear(0, 0, 0, 0);
-
-            // Draw the brush texture to the composite layer
-            grassTexture.render(
-                compositeBrushLayer,
-                x,          // Texture source position x
-                y,          // Texture source position y
-                BRUSH_SIZE, // Texture source width
-                BRUSH_SIZE, // Texture source height
-                0,          // Local space x
-                0,          // Local space y
-                BlendMode::None  // No blending for initial composition
-            );
-
-            // Apply the mask to the composite layer
-            compositeBrushLayer.applyMask(maskTexture);
+            x = (std::cos(time) * 50.0f) + 50.0f;
+            y = (std::sin(time) * 50.0f) + 50.0f;
             
-            // save the composed brush to a file
-            // compositeBrushLayer.save("resources/composite.png");
-
-            // Render the composed brush to the dirt texture
-            compositeBrushLayer.render(
-                dirtTexture,
-                static_cast<int>(x),
-                static_cast<int>(y), 
-                BlendMode::AlphaPreserve
-            );
-            
-            // Draw dirt background with composed brush baked into it to the screen
-            float screen_x = 50.0;
-            float screen_y = 50.0;
-
-            dirtTexture.render(screen_x, screen_y, nullptr);
+            graph.execute();
+            autosave.update();
 
             graphics.render();
         }
@@ -0,0 +1,559 @@
+// pixel_convert.cpp
+#include "pixel_convert.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MUFFIN_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Below this many pixels a conversion isn't worth waking the pool for
+const long kParallelThreshold = 256 * 256;
+
+// Memory offset of each channel inside a pixel; -1 if the format has none
+struct Layout {
+    int bytes;
+    int r, g, b, a;
+};
+
+int byteOffset(Uint32 mask, int bytes) {
+    for (int k = 0; k < bytes; ++k) {
+        if (mask == (0xFFu << (8 * k))) {
+#if SDL_BYTEORDER == SDL_LIL_ENDIAN
+            return k;
+#else
+            return bytes - 1 - k;
+#endif
+        }
+    }
+    return -2;
+}
+
+bool describe(Uint32 format, Layout& layout) {
+    if (SDL_ISPIXELFORMAT_FOURCC(format) || SDL_ISPIXELFORMAT_INDEXED(format)) {
+        return false;
+    }
+    int bpp;
+    Uint32 rmask, gmask, bmask, amask;
+    if (!SDL_PixelFormatEnumToMasks(format, &bpp, &rmask, &gmask, &bmask, &amask)) {
+        return false;
+    }
+    layout.bytes = SDL_BYTESPERPIXEL(format);
+    if (layout.bytes != 3 && layout.bytes != 4) {
+        return false;
+    }
+    layout.r = byteOffset(rmask, layout.bytes);
+    layout.g = byteOffset(gmask, layout.bytes);
+    layout.b = byteOffset(bmask, layout.bytes);
+    layout.a = amask ? byteOffset(amask, layout.bytes) : -1;
+    return layout.r >= 0 && layout.g >= 0 && layout.b >= 0 && layout.a >= -1;
+}
+
+// For each destination byte, the source byte it comes from (-1 = fill 0xFF)
+void buildShuffle(const Layout& source, const Layout& dest, int shuffle[4]) {
+    for (int k = 0; k < 4; ++k) {
+        shuffle[k] = -1;
+    }
+    shuffle[dest.r] = source.r;
+    shuffle[dest.g] = source.g;
+    shuffle[dest.b] = source.b;
+    if (dest.a >= 0) {
+        shuffle[dest.a] = source.a;
+    }
+}
+
+struct CpuFeatures {
+    bool ssse3 = false;
+    bool avx2 = false;
+
+    CpuFeatures() {
+#ifdef MUFFIN_X86_SIMD
+        __builtin_cpu_init();
+        ssse3 = __builtin_cpu_supports("ssse3");
+        avx2 = __builtin_cpu_supports("avx2");
+#endif
+    }
+};
+
+const CpuFeatures& cpu() {
+    static CpuFeatures features;
+    return features;
+}
+
+template <typename RowFunction>
+void forEachRow(int width, int height, RowFunction row) {
+    if (static_cast<long>(width) * height < kParallelThreshold) {
+        for (int y = 0; y < height; ++y) {
+            row(y);
+        }
+        return;
+    }
+    ThreadPool::instance().parallelFor(height, std::max(1, 16384 / std::max(1, width)),
+        [&](int begin, int end) {
+            for (int y = begin; y < end; ++y) {
+                row(y);
+            }
+        });
+}
+
+// ---------------------------------------------------------------------------
+// Scalar kernels
+
+void swizzleRowScalar(const uint8_t* source, uint8_t* dest, int count, int sourceBytes, const int shuffle[4]) {
+    for (int i = 0; i < count; ++i) {
+        for (int k = 0; k < 4; ++k) {
+            dest[k] = shuffle[k] >= 0 ? source[shuffle[k]] : 0xFF;
+        }
+        source += sourceBytes;
+        dest += 4;
+    }
+}
+
+inline uint8_t mulDiv255(unsigned value, unsigned alpha) {
+    unsigned t = value * alpha + 128;
+    return static_cast<uint8_t>((t + (t >> 8)) >> 8);
+}
+
+void premultiplyRowScalar(uint8_t* pixels, int count, int alphaOffset) {
+    for (int i = 0; i < count; ++i) {
+        uint8_t* p = pixels + i * 4;
+        unsigned alpha = p[alphaOffset];
+        for (int k = 0; k < 4; ++k) {
+            if (k != alphaOffset) {
+                p[k] = mulDiv255(p[k], alpha);
+            }
+        }
+    }
+}
+
+// 255 / alpha in 16.16 fixed point, so unpremultiplying is a multiply
+struct UnpremultiplyTable {
+    uint32_t reciprocal[256];
+
+    UnpremultiplyTable() {
+        reciprocal[0] = 0;
+        for (unsigned alpha = 1; alpha < 256; ++alpha) {
+            reciprocal[alpha] = ((255u << 16) + alpha / 2) / alpha;
+        }
+    }
+};
+
+void unpremultiplyRowScalar(uint8_t* pixels, int count, int alphaOffset) {
+    static const UnpremultiplyTable table;
+    for (int i = 0; i < count; ++i) {
+        uint8_t* p = pixels + i * 4;
+        unsigned alpha = p[alphaOffset];
+        if (alpha == 255) {
+            continue;
+        }
+        uint32_t reciprocal = table.reciprocal[alpha];
+        for (int k = 0; k < 4; ++k) {
+            if (k != alphaOffset) {
+                uint32_t value = (p[k] * reciprocal + 0x8000) >> 16;
+                p[k] = static_cast<uint8_t>(value > 255 ? 255 : value);
+            }
+        }
+    }
+}
+
+void expandAlphaRowScalar(const uint8_t* source, uint8_t* dest, int count, int alphaOffset, bool premultiply) {
+    for (int i = 0; i < count; ++i) {
+        uint8_t alpha = source[i];
+        for (int k = 0; k < 4; ++k) {
+            dest[k] = (k == alphaOffset || premultiply) ? alpha : 0xFF;
+        }
+        dest += 4;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// SIMD kernels
+
+#ifdef MUFFIN_X86_SIMD
+
+__attribute__((target("ssse3")))
+int swizzleRowSSSE3(const uint8_t* source, uint8_t* dest, int count, int sourceBytes, const int shuffle[4]) {
+    alignas(16) int8_t mask[16];
+    alignas(16) uint8_t fill[16];
+    for (int p = 0; p < 4; ++p) {
+        for (int k = 0; k < 4; ++k) {
+            mask[p * 4 + k] = shuffle[k] >= 0 ? static_cast<int8_t>(p * sourceBytes + shuffle[k]) : int8_t(-128);
+            fill[p * 4 + k] = shuffle[k] >= 0 ? 0x00 : 0xFF;
+        }
+    }
+    const __m128i shuffleMask = _mm_load_si128(reinterpret_cast<const __m128i*>(mask));
+    const __m128i fillMask = _mm_load_si128(reinterpret_cast<const __m128i*>(fill));
+
+    // Each load reads 16 bytes but only consumes 4 pixels, so stop early
+    // enough that 24-bit rows are never over-read
+    const int safeCount = sourceBytes == 4 ? count : count - 2;
+    int i = 0;
+    for (; i + 4 <= safeCount; i += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i * sourceBytes));
+        v = _mm_or_si128(_mm_shuffle_epi8(v, shuffleMask), fillMask);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i * 4), v);
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+int swizzleRowAVX2(const uint8_t* source, uint8_t* dest, int count, const int shuffle[4]) {
+    alignas(32) int8_t mask[32];
+    alignas(32) uint8_t fill[32];
+    for (int p = 0; p < 8; ++p) {
+        for (int k = 0; k < 4; ++k) {
+            // vpshufb indexes within each 128-bit lane
+            mask[p * 4 + k] = shuffle[k] >= 0 ? static_cast<int8_t>((p % 4) * 4 + shuffle[k]) : int8_t(-128);
+            fill[p * 4 + k] = shuffle[k] >= 0 ? 0x00 : 0xFF;
+        }
+    }
+    const __m256i shuffleMask = _mm256_load_si256(reinterpret_cast<const __m256i*>(mask));
+    const __m256i fillMask = _mm256_load_si256(reinterpret_cast<const __m256i*>(fill));
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i * 4));
+        v = _mm256_or_si256(_mm256_shuffle_epi8(v, shuffleMask), fillMask);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i * 4), v);
+    }
+    return i;
+}
+
+// Broadcasts each pixel's alpha into the 16-bit lanes of its channels, with
+// the alpha lane itself left to be restored from the source
+void buildAlphaMasks(int alphaOffset, int8_t low[16], int8_t high[16], uint8_t keep[16]) {
+    for (int lane = 0; lane < 8; ++lane) {
+        low[lane * 2] = static_cast<int8_t>((lane / 4) * 4 + alphaOffset);
+        low[lane * 2 + 1] = -128;
+        high[lane * 2] = static_cast<int8_t>((lane / 4 + 2) * 4 + alphaOffset);
+        high[lane * 2 + 1] = -128;
+    }
+    for (int k = 0; k < 16; ++k) {
+        keep[k] = (k % 4 == alphaOffset) ? 0xFF : 0x00;
+    }
+}
+
+__attribute__((target("ssse3")))
+int premultiplyRowSSSE3(uint8_t* pixels, int count, int alphaOffset) {
+    alignas(16) int8_t low[16];
+    alignas(16) int8_t high[16];
+    alignas(16) uint8_t keep[16];
+    buildAlphaMasks(alphaOffset, low, high, keep);
+
+    const __m128i alphaLow = _mm_load_si128(reinterpret_cast<const __m128i*>(low));
+    const __m128i alphaHigh = _mm_load_si128(reinterpret_cast<const __m128i*>(high));
+    const __m128i keepAlpha = _mm_load_si128(reinterpret_cast<const __m128i*>(keep));
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias = _mm_set1_epi16(128);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i* p = reinterpret_cast<__m128i*>(pixels + i * 4);
+        __m128i v = _mm_loadu_si128(p);
+
+        __m128i lo = _mm_mullo_epi16(_mm_unpacklo_epi8(v, zero), _mm_shuffle_epi8(v, alphaLow));
+        __m128i hi = _mm_mullo_epi16(_mm_unpackhi_epi8(v, zero), _mm_shuffle_epi8(v, alphaHigh));
+
+        // x / 255 ~= (t + (t >> 8)) >> 8 with t = x + 128
+        lo = _mm_add_epi16(lo, bias);
+        hi = _mm_add_epi16(hi, bias);
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+
+        __m128i result = _mm_packus_epi16(lo, hi);
+        result = _mm_or_si128(_mm_andnot_si128(keepAlpha, result), _mm_and_si128(keepAlpha, v));
+        _mm_storeu_si128(p, result);
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+int premultiplyRowAVX2(uint8_t* pixels, int count, int alphaOffset) {
+    alignas(16) int8_t low[16];
+    alignas(16) int8_t high[16];
+    alignas(16) uint8_t keep[16];
+    buildAlphaMasks(alphaOffset, low, high, keep);
+
+    // Unpack, shuffle and pack all work per 128-bit lane, so the SSE masks
+    // apply to both lanes unchanged
+    const __m256i alphaLow = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(low)));
+    const __m256i alphaHigh = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(high)));
+    const __m256i keepAlpha = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(keep)));
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i bias = _mm256_set1_epi16(128);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i* p = reinterpret_cast<__m256i*>(pixels + i * 4);
+        __m256i v = _mm256_loadu_si256(p);
+
+        __m256i lo = _mm256_mullo_epi16(_mm256_unpacklo_epi8(v, zero), _mm256_shuffle_epi8(v, alphaLow));
+        __m256i hi = _mm256_mullo_epi16(_mm256_unpackhi_epi8(v, zero), _mm256_shuffle_epi8(v, alphaHigh));
+
+        lo = _mm256_add_epi16(lo, bias);
+        hi = _mm256_add_epi16(hi, bias);
+        lo = _mm256_srli_epi16(_mm256_add_epi16(lo, _mm256_srli_epi16(lo, 8)), 8);
+        hi = _mm256_srli_epi16(_mm256_add_epi16(hi, _mm256_srli_epi16(hi, 8)), 8);
+
+        __m256i result = _mm256_packus_epi16(lo, hi);
+        result = _mm256_or_si256(_mm256_andnot_si256(keepAlpha, result), _mm256_and_si256(keepAlpha, v));
+        _mm256_storeu_si256(p, result);
+    }
+    return i;
+}
+
+__attribute__((target("ssse3")))
+int expandAlphaRowSSSE3(const uint8_t* source, uint8_t* dest, int count, int alphaOffset, bool premultiply) {
+    __m128i masks[4];
+    __m128i fills[4];
+    for (int q = 0; q < 4; ++q) {
+        alignas(16) int8_t mask[16];
+        alignas(16) uint8_t fill[16];
+        for (int p = 0; p < 4; ++p) {
+            for (int k = 0; k < 4; ++k) {
+                bool takesAlpha = (k == alphaOffset) || premultiply;
+                mask[p * 4 + k] = takesAlpha ? static_cast<int8_t>(q * 4 + p) : int8_t(-128);
+                fill[p * 4 + k] = takesAlpha ? 0x00 : 0xFF;
+            }
+        }
+        masks[q] = _mm_load_si128(reinterpret_cast<const __m128i*>(mask));
+        fills[q] = _mm_load_si128(reinterpret_cast<const __m128i*>(fill));
+    }
+
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+        for (int q = 0; q < 4; ++q) {
+            __m128i out = _mm_or_si128(_mm_shuffle_epi8(v, masks[q]), fills[q]);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + (i + q * 4) * 4), out);
+        }
+    }
+    return i;
+}
+
+#endif
+
+// ---------------------------------------------------------------------------
+// Row dispatch
+
+void swizzleRow(const uint8_t* source, uint8_t* dest, int count, int sourceBytes, const int shuffle[4]) {
+    int done = 0;
+#ifdef MUFFIN_X86_SIMD
+    if (sourceBytes == 4 && cpu().avx2) {
+        done = swizzleRowAVX2(source, dest, count, shuffle);
+    }
+    if (cpu().ssse3) {
+        done += swizzleRowSSSE3(source + done * sourceBytes, dest + done * 4, count - done, sourceBytes, shuffle);
+    }
+#endif
+    swizzleRowScalar(source + done * sourceBytes, dest + done * 4, count - done, sourceBytes, shuffle);
+}
+
+void premultiplyRow(uint8_t* pixels, int count, int alphaOffset) {
+    int done = 0;
+#ifdef MUFFIN_X86_SIMD
+    if (cpu().avx2) {
+        done = premultiplyRowAVX2(pixels, count, alphaOffset);
+    }
+    if (cpu().ssse3) {
+        done += premultiplyRowSSSE3(pixels + done * 4, count - done, alphaOffset);
+    }
+#endif
+    premultiplyRowScalar(pixels + done * 4, count - done, alphaOffset);
+}
+
+void expandAlphaRow(const uint8_t* source, uint8_t* dest, int count, int alphaOffset, bool premultiply) {
+    int done = 0;
+#ifdef MUFFIN_X86_SIMD
+    if (cpu().ssse3) {
+        done = expandAlphaRowSSSE3(source, dest, count, alphaOffset, premultiply);
+    }
+#endif
+    expandAlphaRowScalar(source + done, dest + done * 4, count - done, alphaOffset, premultiply);
+}
+
+bool describeDest(Uint32 format, Layout& layout) {
+    return describe(format, layout) && layout.bytes == 4;
+}
+
+} // namespace
+
+namespace PixelConvert {
+
+bool isSupported(Uint32 sourceFormat, Uint32 destFormat) {
+    Layout dest;
+    if (!describeDest(destFormat, dest)) {
+        return false;
+    }
+    if (sourceFormat == SDL_PIXELFORMAT_INDEX8) {
+        return true;
+    }
+    Layout source;
+    return describe(sourceFormat, source);
+}
+
+bool convert(const void* source, int sourcePitch, Uint32 sourceFormat,
+             void* dest, int destPitch, Uint32 destFormat,
+             int width, int height,
+             bool premultiply,
+             const SDL_Palette* palette) {
+    Layout to;
+    if (!describeDest(destFormat, to)) {
+        return false;
+    }
+    premultiply = premultiply && to.a >= 0;
+
+    const uint8_t* src = static_cast<const uint8_t*>(source);
+    uint8_t* dst = static_cast<uint8_t*>(dest);
+
+    if (sourceFormat == SDL_PIXELFORMAT_INDEX8) {
+        if (!palette) {
+            return false;
+        }
+
+        // Palettized and grayscale images go through a lookup table built
+        // directly in the destination layout
+        uint32_t table[256] = {};
+        for (int i = 0; i < palette->ncolors && i < 256; ++i) {
+            const SDL_Color& c = palette->colors[i];
+            uint8_t bytes[4] = { 0xFF, 0xFF, 0xFF, 0xFF };
+            bytes[to.r] = c.r;
+            bytes[to.g] = c.g;
+            bytes[to.b] = c.b;
+            if (to.a >= 0) {
+                bytes[to.a] = c.a;
+            }
+            if (premultiply) {
+                premultiplyRowScalar(bytes, 1, to.a);
+            }
+            std::memcpy(&table[i], bytes, 4);
+        }
+
+        forEachRow(width, height, [&](int y) {
+            const uint8_t* in = src + static_cast<size_t>(y) * sourcePitch;
+            uint32_t* out = reinterpret_cast<uint32_t*>(dst + static_cast<size_t>(y) * destPitch);
+            for (int x = 0; x < width; ++x) {
+                out[x] = table[in[x]];
+            }
+        });
+        return true;
+    }
+
+    Layout from;
+    if (!describe(sourceFormat, from)) {
+        return false;
+    }
+
+    int shuffle[4];
+    buildShuffle(from, to, shuffle);
+
+    forEachRow(width, height, [&](int y) {
+        const uint8_t* in = src + static_cast<size_t>(y) * sourcePitch;
+        uint8_t* out = dst + static_cast<size_t>(y) * destPitch;
+        swizzleRow(in, out, width, from.bytes, shuffle);
+        if (premultiply && from.a >= 0) {
+            premultiplyRow(out, width, to.a);
+        }
+    });
+    return true;
+}
+
+void expandAlpha(const uint8_t* source, int sourcePitch,
+                 void* dest, int destPitch, Uint32 destFormat,
+                 int width, int height,
+                 bool premultiply) {
+    Layout to;
+    if (!describeDest(destFormat, to) || to.a < 0) {
+        return;
+    }
+    uint8_t* dst = static_cast<uint8_t*>(dest);
+
+    forEachRow(width, height, [&](int y) {
+        expandAlphaRow(source + static_cast<size_t>(y) * sourcePitch,
+                       dst + static_cast<size_t>(y) * destPitch,
+                       width, to.a, premultiply);
+    });
+}
+
+void premultiply(void* pixels, int pitch, Uint32 format, int width, int height) {
+    Layout layout;
+    if (!describeDest(format, layout) || layout.a < 0) {
+        return;
+    }
+    uint8_t* base = static_cast<uint8_t*>(pixels);
+
+    forEachRow(width, height, [&](int y) {
+        premultiplyRow(base + static_cast<size_t>(y) * pitch, width, layout.a);
+    });
+}
+
+void unpremultiply(void* pixels, int pitch, Uint32 format, int width, int height) {
+    Layout layout;
+    if (!describeDest(format, layout) || layout.a < 0) {
+        return;
+    }
+    uint8_t* base = static_cast<uint8_t*>(pixels);
+
+    forEachRow(width, height, [&](int y) {
+        unpremultiplyRowScalar(base + static_cast<size_t>(y) * pitch, width, layout.a);
+    });
+}
+
+SDL_Surface* convertSurface(SDL_Surface* surface, Uint32 destFormat, bool premultiply) {
+    const Uint32 sourceFormat = surface->format->format;
+
+    // Color keys on non-palettized images are rare; leave them to SDL
+    bool keyed = SDL_HasColorKey(surface) == SDL_TRUE;
+    bool handled = isSupported(sourceFormat, destFormat)
+                   && (!keyed || sourceFormat == SDL_PIXELFORMAT_INDEX8);
+
+    if (!handled) {
+        SDL_Surface* converted = SDL_ConvertSurfaceFormat(surface, destFormat, 0);
+        if (converted && premultiply) {
+            PixelConvert::premultiply(converted->pixels, converted->pitch, destFormat, converted->w, converted->h);
+        }
+        return converted;
+    }
+
+    SDL_Surface* converted = SDL_CreateRGBSurfaceWithFormat(0, surface->w, surface->h, 32, destFormat);
+    if (!converted) {
+        return nullptr;
+    }
+
+    SDL_Palette* palette = surface->format->palette;
+    SDL_Palette* keyedPalette = nullptr;
+    if (keyed && palette) {
+        // The color key becomes a transparent palette entry
+        Uint32 key = 0;
+        SDL_GetColorKey(surface, &key);
+        keyedPalette = SDL_AllocPalette(palette->ncolors);
+        if (keyedPalette) {
+            SDL_SetPaletteColors(keyedPalette, palette->colors, 0, palette->ncolors);
+            if (static_cast<int>(key) < keyedPalette->ncolors) {
+                keyedPalette->colors[key].a = 0;
+            }
+            palette = keyedPalette;
+        }
+    }
+
+    if (SDL_MUSTLOCK(surface)) {
+        SDL_LockSurface(surface);
+    }
+    convert(surface->pixels, surface->pitch, sourceFormat,
+            converted->pixels, converted->pitch, destFormat,
+            surface->w, surface->h, premultiply, palette);
+    if (SDL_MUSTLOCK(surface)) {
+        SDL_UnlockSurface(surface);
+    }
+
+    if (keyedPalette) {
+        SDL_FreePalette(keyedPalette);
+    }
+    return converted;
+}
+
+}
@@ -0,0 +1,42 @@
+// pixel_convert.hpp
+#pragma once
+#include <SDL2/SDL.h>
+#include <cstdint>
+
+// Pixel format conversion for load paths. Covers byte swizzles between the
+// packed 32-bit formats (RGBA/ABGR/ARGB/BGRA and their X variants), RGB24 and
+// BGR24 expansion, 8-bit palettized or grayscale images and 8-bit alpha
+// masks. Uses SSSE3/AVX2 when the CPU has them and splits large images into
+// row bands on the shared ThreadPool.
+namespace PixelConvert {
+
+    // True if convert() handles this pair itself
+    bool isSupported(Uint32 sourceFormat, Uint32 destFormat);
+
+    // Converts a width x height block. INDEX8 sources need a palette.
+    // Returns false if the pair is not supported.
+    bool convert(const void* source, int sourcePitch, Uint32 sourceFormat,
+                 void* dest, int destPitch, Uint32 destFormat,
+                 int width, int height,
+                 bool premultiply = false,
+                 const SDL_Palette* palette = nullptr);
+
+    // Expands an 8-bit coverage mask into white pixels with that alpha
+    void expandAlpha(const uint8_t* source, int sourcePitch,
+                     void* dest, int destPitch, Uint32 destFormat,
+                     int width, int height,
+                     bool premultiply = false);
+
+    // Multiplies color by alpha in place for a packed 32-bit format with alpha
+    void premultiply(void* pixels, int pitch, Uint32 format, int width, int height);
+
+    // Divides color by alpha in place, undoing premultiply(). Fully
+    // transparent pixels become transparent black.
+    void unpremultiply(void* pixels, int pitch, Uint32 format, int width, int height);
+
+    // Returns a new surface in destFormat. Uses the kernels above when
+    // possible and SDL_ConvertSurfaceFormat otherwise; the caller owns the
+    // result and still owns the source.
+    SDL_Surface* convertSurface(SDL_Surface* surface, Uint32 destFormat, bool premultiply = false);
+
+}
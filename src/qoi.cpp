@@ -0,0 +1,268 @@
+// qoi.cpp
+#include "qoi.hpp"
+#include "pixel_convert.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+const uint8_t kOpIndex = 0x00;
+const uint8_t kOpDiff = 0x40;
+const uint8_t kOpLuma = 0x80;
+const uint8_t kOpRun = 0xc0;
+const uint8_t kOpRgb = 0xfe;
+const uint8_t kOpRgba = 0xff;
+const uint8_t kMask2 = 0xc0;
+
+const size_t kHeaderSize = 14;
+const uint8_t kEndMarker[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+
+// Rows converted and encoded per chunk
+const int kChunkRows = 32;
+
+// Refuse images whose RGBA size wouldn't fit comfortably in memory
+const uint64_t kMaxPixels = 400000000ULL;
+
+// Pixels are handled as four bytes in R, G, B, A memory order packed into a
+// uint32_t, so equality is one compare
+inline uint32_t pack(const uint8_t* p) {
+    uint32_t value;
+    std::memcpy(&value, p, 4);
+    return value;
+}
+
+inline uint8_t channel(uint32_t pixel, int i) {
+    uint8_t bytes[4];
+    std::memcpy(bytes, &pixel, 4);
+    return bytes[i];
+}
+
+inline int hashPixel(const uint8_t* p) {
+    return (p[0] * 3 + p[1] * 5 + p[2] * 7 + p[3] * 11) % 64;
+}
+
+void writeBigEndian(uint8_t* out, uint32_t value) {
+    out[0] = static_cast<uint8_t>(value >> 24);
+    out[1] = static_cast<uint8_t>(value >> 16);
+    out[2] = static_cast<uint8_t>(value >> 8);
+    out[3] = static_cast<uint8_t>(value);
+}
+
+uint32_t readBigEndian(const uint8_t* in) {
+    return (static_cast<uint32_t>(in[0]) << 24) | (static_cast<uint32_t>(in[1]) << 16)
+         | (static_cast<uint32_t>(in[2]) << 8) | in[3];
+}
+
+} // namespace
+
+namespace Qoi {
+
+bool isQoi(const void* data, size_t size) {
+    return size >= kHeaderSize && std::memcmp(data, "qoif", 4) == 0;
+}
+
+Encoder::Encoder(std::ostream& out, int width, int height)
+    : m_out(out)
+    , m_width(width)
+    , m_height(height)
+{
+    const uint8_t start[4] = { 0, 0, 0, 255 };
+    m_previous = pack(start);
+
+    uint8_t header[kHeaderSize];
+    std::memcpy(header, "qoif", 4);
+    writeBigEndian(header + 4, static_cast<uint32_t>(width));
+    writeBigEndian(header + 8, static_cast<uint32_t>(height));
+    header[12] = 4;     // RGBA
+    header[13] = 0;     // sRGB with linear alpha
+    m_out.write(reinterpret_cast<const char*>(header), kHeaderSize);
+
+    m_rgba.resize(static_cast<size_t>(width) * kChunkRows * 4);
+}
+
+void Encoder::writeRows(const void* pixels, int pitch, Uint32 format, int rows) {
+    const uint8_t* source = static_cast<const uint8_t*>(pixels);
+    rows = std::min(rows, m_height - m_rowsWritten);
+
+    for (int y = 0; y < rows; y += kChunkRows) {
+        const int chunk = std::min(kChunkRows, rows - y);
+        const uint8_t* rgba = source + static_cast<size_t>(y) * pitch;
+        if (format != SDL_PIXELFORMAT_RGBA32) {
+            PixelConvert::convert(rgba, pitch, format,
+                                  m_rgba.data(), m_width * 4, SDL_PIXELFORMAT_RGBA32,
+                                  m_width, chunk);
+            rgba = m_rgba.data();
+            encode(rgba, static_cast<size_t>(m_width) * chunk);
+        } else if (pitch == m_width * 4) {
+            encode(rgba, static_cast<size_t>(m_width) * chunk);
+        } else {
+            for (int row = 0; row < chunk; ++row) {
+                encode(rgba + static_cast<size_t>(row) * pitch, m_width);
+            }
+        }
+
+        m_out.write(reinterpret_cast<const char*>(m_buffer.data()), static_cast<std::streamsize>(m_buffer.size()));
+        m_buffer.clear();
+    }
+    m_rowsWritten += rows;
+}
+
+void Encoder::encode(const uint8_t* rgba, size_t count) {
+    // Worst case is five bytes per pixel
+    const size_t start = m_buffer.size();
+    m_buffer.resize(start + count * 5 + 1);
+    uint8_t* out = m_buffer.data() + start;
+
+    uint32_t previous = m_previous;
+    int run = m_run;
+
+    for (size_t i = 0; i < count; ++i) {
+        const uint8_t* p = rgba + i * 4;
+        const uint32_t pixel = pack(p);
+
+        if (pixel == previous) {
+            if (++run == 62) {
+                *out++ = kOpRun | (run - 1);
+                run = 0;
+            }
+            continue;
+        }
+        if (run > 0) {
+            *out++ = kOpRun | (run - 1);
+            run = 0;
+        }
+
+        const int slot = hashPixel(p);
+        if (m_index[slot] == pixel) {
+            *out++ = kOpIndex | slot;
+        } else {
+            m_index[slot] = pixel;
+
+            if (p[3] == channel(previous, 3)) {
+                const int8_t dr = static_cast<int8_t>(p[0] - channel(previous, 0));
+                const int8_t dg = static_cast<int8_t>(p[1] - channel(previous, 1));
+                const int8_t db = static_cast<int8_t>(p[2] - channel(previous, 2));
+                const int8_t drDg = static_cast<int8_t>(dr - dg);
+                const int8_t dbDg = static_cast<int8_t>(db - dg);
+
+                if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+                    *out++ = kOpDiff | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2);
+                } else if (dg >= -32 && dg <= 31 && drDg >= -8 && drDg <= 7 && dbDg >= -8 && dbDg <= 7) {
+                    *out++ = kOpLuma | (dg + 32);
+                    *out++ = ((drDg + 8) << 4) | (dbDg + 8);
+                } else {
+                    *out++ = kOpRgb;
+                    *out++ = p[0];
+                    *out++ = p[1];
+                    *out++ = p[2];
+                }
+            } else {
+                *out++ = kOpRgba;
+                *out++ = p[0];
+                *out++ = p[1];
+                *out++ = p[2];
+                *out++ = p[3];
+            }
+        }
+        previous = pixel;
+    }
+
+    m_previous = previous;
+    m_run = run;
+    m_buffer.resize(out - m_buffer.data());
+}
+
+bool Encoder::finish() {
+    if (m_run > 0) {
+        const uint8_t op = kOpRun | (m_run - 1);
+        m_out.write(reinterpret_cast<const char*>(&op), 1);
+        m_run = 0;
+    }
+    m_out.write(reinterpret_cast<const char*>(kEndMarker), sizeof(kEndMarker));
+    m_out.flush();
+    return m_out.good() && m_rowsWritten == m_height;
+}
+
+SDL_Surface* decode(const void* data, size_t size, Uint32 destFormat) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    if (!isQoi(data, size)) {
+        SDL_SetError("Not a QOI image");
+        return nullptr;
+    }
+    const uint32_t width = readBigEndian(bytes + 4);
+    const uint32_t height = readBigEndian(bytes + 8);
+    if (width == 0 || height == 0 || static_cast<uint64_t>(width) * height > kMaxPixels) {
+        SDL_SetError("Invalid QOI image size");
+        return nullptr;
+    }
+
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, destFormat);
+    if (!surface) {
+        return nullptr;
+    }
+
+    // Decode a chunk of rows to RGBA, then convert it into the surface
+    const bool direct = destFormat == SDL_PIXELFORMAT_RGBA32;
+    std::vector<uint8_t> rgba(direct ? 0 : static_cast<size_t>(width) * kChunkRows * 4);
+
+    uint8_t index[64][4] = {};
+    uint8_t pixel[4] = { 0, 0, 0, 255 };
+    int run = 0;
+    // Ops never read more than four bytes past their first, so stopping at
+    // the end marker keeps every read inside the data. Missing pixels repeat
+    // the last one, as in the reference decoder.
+    const uint8_t* in = bytes + kHeaderSize;
+    const uint8_t* end = bytes + std::max(kHeaderSize, size - sizeof(kEndMarker));
+
+    for (uint32_t y = 0; y < height; y += kChunkRows) {
+        const int chunk = static_cast<int>(std::min<uint32_t>(kChunkRows, height - y));
+        uint8_t* surfaceRows = static_cast<uint8_t*>(surface->pixels) + static_cast<size_t>(y) * surface->pitch;
+
+        for (int row = 0; row < chunk; ++row) {
+            uint8_t* out = direct ? surfaceRows + static_cast<size_t>(row) * surface->pitch
+                                  : rgba.data() + static_cast<size_t>(row) * width * 4;
+            for (uint32_t x = 0; x < width; ++x, out += 4) {
+                if (run > 0) {
+                    run--;
+                } else if (in < end) {
+                    const uint8_t op = *in++;
+                    if (op == kOpRgb) {
+                        pixel[0] = in[0];
+                        pixel[1] = in[1];
+                        pixel[2] = in[2];
+                        in += 3;
+                    } else if (op == kOpRgba) {
+                        std::memcpy(pixel, in, 4);
+                        in += 4;
+                    } else if ((op & kMask2) == kOpIndex) {
+                        std::memcpy(pixel, index[op], 4);
+                    } else if ((op & kMask2) == kOpDiff) {
+                        pixel[0] += ((op >> 4) & 0x03) - 2;
+                        pixel[1] += ((op >> 2) & 0x03) - 2;
+                        pixel[2] += (op & 0x03) - 2;
+                    } else if ((op & kMask2) == kOpLuma) {
+                        const uint8_t second = *in++;
+                        const int dg = (op & 0x3f) - 32;
+                        pixel[0] += dg - 8 + ((second >> 4) & 0x0f);
+                        pixel[1] += dg;
+                        pixel[2] += dg - 8 + (second & 0x0f);
+                    } else {
+                        run = op & 0x3f;
+                    }
+                    std::memcpy(index[hashPixel(pixel)], pixel, 4);
+                }
+                std::memcpy(out, pixel, 4);
+            }
+        }
+
+        if (!direct) {
+            PixelConvert::convert(rgba.data(), width * 4, SDL_PIXELFORMAT_RGBA32,
+                                  surfaceRows, surface->pitch, destFormat,
+                                  width, chunk);
+        }
+    }
+
+    return surface;
+}
+
+}
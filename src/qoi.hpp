@@ -0,0 +1,50 @@
+// qoi.hpp
+#pragma once
+#include <SDL2/SDL.h>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// Lossless "Quite OK Image" codec used for fast snapshots. Encodes several
+// times faster than PNG; painted content with flat areas and gradients
+// compresses to a similar size. Files follow the QOI spec (RGBA, sRGB), so
+// other tools can open them.
+namespace Qoi {
+
+    // True if data starts with a QOI header
+    bool isQoi(const void* data, size_t size);
+
+    // Streaming encoder. Rows can be fed in any number of calls; output is
+    // written to the stream chunk by chunk rather than built up in memory.
+    class Encoder {
+    public:
+        // Writes the header
+        Encoder(std::ostream& out, int width, int height);
+
+        // Encodes rows given in any packed 32-bit format PixelConvert handles
+        void writeRows(const void* pixels, int pitch, Uint32 format, int rows);
+
+        // Writes the end marker. Returns false if the stream failed or the
+        // rows written don't add up to the image height.
+        bool finish();
+
+    private:
+        void encode(const uint8_t* rgba, size_t count);
+
+        std::ostream& m_out;
+        int m_width;
+        int m_height;
+        int m_rowsWritten = 0;
+        uint32_t m_index[64] = {};
+        uint32_t m_previous;
+        int m_run = 0;
+        std::vector<uint8_t> m_rgba;       // Converted rows of the current chunk
+        std::vector<uint8_t> m_buffer;     // Encoded bytes of the current chunk
+    };
+
+    // Decodes a whole file into a new surface in destFormat. Returns nullptr
+    // and sets the SDL error on malformed data; the caller owns the result.
+    SDL_Surface* decode(const void* data, size_t size, Uint32 destFormat);
+
+}
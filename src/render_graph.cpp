@@ -0,0 +1,267 @@
+// render_graph.cpp
+#include "render_graph.hpp"
+#include "graphics.hpp"
+#include "texture.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+bool intersects(const std::vector<int>& a, const std::vector<int>& b) {
+    for (int x : a) {
+        if (std::find(b.begin(), b.end(), x) != b.end()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+Texture& RenderGraph::PassContext::texture(ResourceId id) const {
+    if (id <= Backbuffer || id >= static_cast<int>(m_graph.m_resources.size())) {
+        throw std::runtime_error("Render graph resource has no texture");
+    }
+    Texture* texture = m_graph.m_resources[id].texture;
+    if (!texture) {
+        throw std::runtime_error("Render graph resource '" + m_graph.m_resources[id].name
+                                 + "' is not allocated");
+    }
+    return *texture;
+}
+
+RenderGraph::RenderGraph(Graphics& graphics)
+    : m_graphics(graphics)
+{
+    m_resources.push_back(Resource{ "backbuffer", nullptr, false, 0, 0 });
+}
+
+RenderGraph::~RenderGraph() = default;
+
+RenderGraph::ResourceId RenderGraph::import(Texture& texture, const std::string& name) {
+    m_resources.push_back(Resource{ name, &texture, false, texture.getWidth(), texture.getHeight() });
+    m_compiled = false;
+    return static_cast<ResourceId>(m_resources.size() - 1);
+}
+
+RenderGraph::ResourceId RenderGraph::createTransient(const std::string& name, int width, int height) {
+    if (width <= 0 || height <= 0) {
+        throw std::runtime_error("Transient '" + name + "' must have a positive size");
+    }
+    m_resources.push_back(Resource{ name, nullptr, true, width, height });
+    m_compiled = false;
+    return static_cast<ResourceId>(m_resources.size() - 1);
+}
+
+void RenderGraph::addPass(const std::string& name,
+                          const std::vector<ResourceId>& reads,
+                          const std::vector<ResourceId>& writes,
+                          PassFunction execute) {
+    for (ResourceId id : reads) {
+        if (id < 0 || id >= static_cast<int>(m_resources.size())) {
+            throw std::runtime_error("Pass '" + name + "' reads an unknown resource");
+        }
+    }
+    for (ResourceId id : writes) {
+        if (id < 0 || id >= static_cast<int>(m_resources.size())) {
+            throw std::runtime_error("Pass '" + name + "' writes an unknown resource");
+        }
+    }
+    if (writes.empty()) {
+        throw std::runtime_error("Pass '" + name + "' must write at least one resource");
+    }
+
+    m_passes.push_back(Pass{ name, reads, writes, std::move(execute) });
+    m_compiled = false;
+}
+
+void RenderGraph::cullPasses(std::vector<bool>& live) const {
+    // Walk backwards from passes with visible side effects (writes to the
+    // backbuffer or to imported textures) and keep everything they need
+    std::vector<bool> needed(m_resources.size(), false);
+    live.assign(m_passes.size(), false);
+
+    for (int i = static_cast<int>(m_passes.size()) - 1; i >= 0; --i) {
+        const Pass& pass = m_passes[i];
+        for (ResourceId id : pass.writes) {
+            if (!m_resources[id].transient || needed[id]) {
+                live[i] = true;
+                break;
+            }
+        }
+        if (live[i]) {
+            for (ResourceId id : pass.reads) {
+                needed[id] = true;
+            }
+        }
+    }
+}
+
+void RenderGraph::schedule(const std::vector<bool>& live) {
+    const int count = static_cast<int>(m_passes.size());
+
+    // Edges follow declaration order for read-after-write, write-after-read
+    // and write-after-write hazards
+    std::vector<std::vector<int>> dependents(count);
+    std::vector<int> pending(count, 0);
+    for (int i = 0; i < count; ++i) {
+        if (!live[i]) continue;
+        for (int j = i + 1; j < count; ++j) {
+            if (!live[j]) continue;
+            const Pass& a = m_passes[i];
+            const Pass& b = m_passes[j];
+            if (intersects(a.writes, b.reads) || intersects(a.reads, b.writes)
+                || intersects(a.writes, b.writes)) {
+                dependents[i].push_back(j);
+                pending[j]++;
+            }
+        }
+    }
+
+    m_order.clear();
+    m_groups.clear();
+
+    std::vector<bool> done(count, false);
+    int remaining = static_cast<int>(std::count(live.begin(), live.end(), true));
+    ResourceId lastTarget = -1;
+    int group = -1;
+
+    while (remaining > 0) {
+        // Prefer a ready pass that keeps writing the current target so the
+        // two can share a bind; otherwise take the earliest declared one
+        int pick = -1;
+        for (int i = 0; i < count; ++i) {
+            if (!live[i] || done[i] || pending[i] > 0) continue;
+            if (pick < 0) {
+                pick = i;
+            }
+            if (m_passes[i].writes.front() == lastTarget) {
+                pick = i;
+                break;
+            }
+        }
+
+        done[pick] = true;
+        remaining--;
+        for (int dependent : dependents[pick]) {
+            pending[dependent]--;
+        }
+
+        ResourceId target = m_passes[pick].writes.front();
+        if (target != lastTarget) {
+            group++;
+            lastTarget = target;
+        }
+        m_order.push_back(pick);
+        m_groups.push_back(group);
+    }
+}
+
+void RenderGraph::allocateTransients() {
+    const int resourceCount = static_cast<int>(m_resources.size());
+    std::vector<int> firstUse(resourceCount, -1);
+    std::vector<int> lastUse(resourceCount, -1);
+
+    for (int slot = 0; slot < static_cast<int>(m_order.size()); ++slot) {
+        const Pass& pass = m_passes[m_order[slot]];
+        for (const std::vector<ResourceId>* list : { &pass.reads, &pass.writes }) {
+            for (ResourceId id : *list) {
+                if (firstUse[id] < 0) firstUse[id] = slot;
+                lastUse[id] = slot;
+            }
+        }
+    }
+
+    for (PooledTarget& target : m_pool) {
+        target.busyUntil = -1;
+    }
+    for (Resource& resource : m_resources) {
+        if (resource.transient) {
+            resource.texture = nullptr;
+        }
+    }
+
+    // Assign transients in order of first use. A pooled target can be shared
+    // by any resource of the same size that starts after its last user ends.
+    std::vector<int> transients;
+    for (int id = 0; id < resourceCount; ++id) {
+        if (m_resources[id].transient && firstUse[id] >= 0) {
+            transients.push_back(id);
+        }
+    }
+    std::stable_sort(transients.begin(), transients.end(),
+        [&](int a, int b) { return firstUse[a] < firstUse[b]; });
+
+    for (int id : transients) {
+        Resource& resource = m_resources[id];
+        PooledTarget* match = nullptr;
+        for (PooledTarget& target : m_pool) {
+            if (target.width == resource.width && target.height == resource.height
+                && target.busyUntil < firstUse[id]) {
+                match = &target;
+                break;
+            }
+        }
+        if (!match) {
+            m_pool.push_back(PooledTarget{
+                std::make_unique<Texture>(Texture::create(m_graphics, resource.width, resource.height)),
+                resource.width, resource.height, -1
+            });
+            match = &m_pool.back();
+        }
+        match->busyUntil = lastUse[id];
+        resource.texture = match->texture.get();
+    }
+}
+
+void RenderGraph::compile() {
+    std::vector<bool> live;
+    cullPasses(live);
+    schedule(live);
+    allocateTransients();
+    m_compiled = true;
+}
+
+void RenderGraph::execute() {
+    if (!m_compiled) {
+        compile();
+    }
+
+    SDL_Renderer* renderer = m_graphics.getRenderer();
+    SDL_Texture* previousTarget = SDL_GetRenderTarget(renderer);
+    PassContext context(m_graphics, *this);
+
+    m_timings.clear();
+    const double frequency = static_cast<double>(SDL_GetPerformanceFrequency());
+
+    for (size_t slot = 0; slot < m_order.size(); ++slot) {
+        const Pass& pass = m_passes[m_order[slot]];
+
+        // Bind once per group; the binds inside Texture's own calls then
+        // find the target already set
+        if (slot == 0 || m_groups[slot] != m_groups[slot - 1]) {
+            const Resource& target = m_resources[pass.writes.front()];
+            SDL_SetRenderTarget(renderer, target.texture ? target.texture->m_texture : nullptr);
+        }
+
+        Uint64 start = SDL_GetPerformanceCounter();
+        pass.execute(context);
+        Uint64 end = SDL_GetPerformanceCounter();
+
+        m_timings.push_back(PassTiming{
+            pass.name,
+            static_cast<double>(end - start) * 1000.0 / frequency,
+            m_groups[slot]
+        });
+    }
+
+    SDL_SetRenderTarget(renderer, previousTarget);
+}
+
+size_t RenderGraph::getTransientMemory() const {
+    size_t bytes = 0;
+    for (const PooledTarget& target : m_pool) {
+        bytes += static_cast<size_t>(target.width) * target.height * 4;
+    }
+    return bytes;
+}
@@ -0,0 +1,115 @@
+// render_graph.hpp
+#pragma once
+#include <SDL2/SDL.h>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+class Graphics;
+class Texture;
+
+// Schedules a list of compositing passes. Passes declare which resources
+// they read and write; the graph orders them, drops passes whose output is
+// never used, backs transient resources with pooled render targets that are
+// shared between resources whose lifetimes don't overlap, and binds each
+// render target once for consecutive passes that write to it.
+//
+// The graph is built once and executed every frame. Pass callbacks can
+// capture per-frame state by reference.
+class RenderGraph {
+public:
+    using ResourceId = int;
+
+    // The window's backbuffer, always available
+    static constexpr ResourceId Backbuffer = 0;
+
+    class PassContext {
+    public:
+        Graphics& getGraphics() const { return m_graphics; }
+
+        // Texture bound to an imported or transient resource. Transient
+        // contents are undefined when the first writer runs.
+        Texture& texture(ResourceId id) const;
+
+    private:
+        friend class RenderGraph;
+        PassContext(Graphics& graphics, const RenderGraph& graph)
+            : m_graphics(graphics), m_graph(graph) {}
+
+        Graphics& m_graphics;
+        const RenderGraph& m_graph;
+    };
+
+    using PassFunction = std::function<void(PassContext&)>;
+
+    explicit RenderGraph(Graphics& graphics);
+    ~RenderGraph();
+
+    // Prevent copying
+    RenderGraph(const RenderGraph&) = delete;
+    RenderGraph& operator=(const RenderGraph&) = delete;
+
+    // Resources
+    ResourceId import(Texture& texture, const std::string& name);
+    ResourceId createTransient(const std::string& name, int width, int height);
+
+    // Passes run in dependency order; independent passes keep declaration order
+    void addPass(const std::string& name,
+                 const std::vector<ResourceId>& reads,
+                 const std::vector<ResourceId>& writes,
+                 PassFunction execute);
+
+    // Runs every live pass. Compiles the graph first if it changed.
+    void execute();
+
+    struct PassTiming {
+        std::string name;
+        double milliseconds;    // CPU time spent submitting the pass
+        int group;              // Passes in the same group share a target bind
+    };
+
+    // Timings from the most recent execute(), in execution order
+    const std::vector<PassTiming>& getTimings() const { return m_timings; }
+
+    // Number of pooled render targets and the memory they occupy
+    size_t getTransientTargetCount() const { return m_pool.size(); }
+    size_t getTransientMemory() const;
+
+private:
+    struct Resource {
+        std::string name;
+        Texture* texture;       // Imported texture, or pooled target once compiled
+        bool transient;
+        int width;
+        int height;
+    };
+
+    struct Pass {
+        std::string name;
+        std::vector<ResourceId> reads;
+        std::vector<ResourceId> writes;
+        PassFunction execute;
+    };
+
+    struct PooledTarget {
+        std::unique_ptr<Texture> texture;
+        int width;
+        int height;
+        int busyUntil;          // Last schedule slot using this target, -1 when free
+    };
+
+    void compile();
+    void cullPasses(std::vector<bool>& live) const;
+    void schedule(const std::vector<bool>& live);
+    void allocateTransients();
+
+    Graphics& m_graphics;
+    std::vector<Resource> m_resources;
+    std::vector<Pass> m_passes;
+    std::vector<int> m_order;       // Pass indices in execution order
+    std::vector<int> m_groups;      // Group index for each entry in m_order
+    std::vector<PooledTarget> m_pool;
+    std::vector<PassTiming> m_timings;
+    bool m_compiled = false;
+};
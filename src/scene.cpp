@@ -0,0 +1,285 @@
+// scene.cpp
+#include "scene.hpp"
+#include "camera.hpp"
+#include "graphics.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+
+const float kDefaultCellSize = 256.0f;
+const float kMinCellSize = 16.0f;
+const float kMaxCellSize = 4096.0f;
+
+// Instances covering more cells than this go on the oversized list
+const long kMaxCellsPerInstance = 64;
+
+// Don't retune for tiny scenes
+const size_t kMinTuneCount = 32;
+
+} // namespace
+
+Scene::Scene(float cellSize)
+    : m_autoCellSize(cellSize <= 0.0f)
+    , m_cellSize(cellSize > 0.0f ? cellSize : kDefaultCellSize)
+{
+    m_stats.cellSize = m_cellSize;
+}
+
+Scene::CellRange Scene::cellsFor(const Rectangle& bounds) const {
+    return CellRange{
+        static_cast<int>(std::floor(bounds.x / m_cellSize)),
+        static_cast<int>(std::floor(bounds.y / m_cellSize)),
+        static_cast<int>(std::floor(bounds.right() / m_cellSize)),
+        static_cast<int>(std::floor(bounds.bottom() / m_cellSize))
+    };
+}
+
+void Scene::link(Handle handle) {
+    Slot& slot = m_slots[handle];
+    CellRange range = cellsFor(slot.instance.bounds);
+    slot.minX = range.minX;
+    slot.minY = range.minY;
+    slot.maxX = range.maxX;
+    slot.maxY = range.maxY;
+
+    long cells = static_cast<long>(range.maxX - range.minX + 1) * (range.maxY - range.minY + 1);
+    slot.oversized = cells > kMaxCellsPerInstance;
+    if (slot.oversized) {
+        m_oversized.push_back(handle);
+        return;
+    }
+
+    for (int y = range.minY; y <= range.maxY; ++y) {
+        for (int x = range.minX; x <= range.maxX; ++x) {
+            m_cells[cellKey(x, y)].push_back(handle);
+        }
+    }
+}
+
+void Scene::unlink(Handle handle) {
+    Slot& slot = m_slots[handle];
+    auto erase = [handle](std::vector<Handle>& list) {
+        auto it = std::find(list.begin(), list.end(), handle);
+        if (it != list.end()) {
+            *it = list.back();
+            list.pop_back();
+        }
+    };
+
+    if (slot.oversized) {
+        erase(m_oversized);
+        return;
+    }
+
+    for (int y = slot.minY; y <= slot.maxY; ++y) {
+        for (int x = slot.minX; x <= slot.maxX; ++x) {
+            auto cell = m_cells.find(cellKey(x, y));
+            if (cell == m_cells.end()) continue;
+            erase(cell->second);
+            if (cell->second.empty()) {
+                m_cells.erase(cell);
+            }
+        }
+    }
+}
+
+Scene::Handle Scene::insert(Texture& texture, float x, float y) {
+    return insert(texture, SDL_Rect{ 0, 0, texture.getWidth(), texture.getHeight() }, x, y);
+}
+
+Scene::Handle Scene::insert(Texture& texture, const SDL_Rect& source, float x, float y) {
+    Handle handle;
+    if (!m_free.empty()) {
+        handle = m_free.back();
+        m_free.pop_back();
+    } else {
+        handle = static_cast<Handle>(m_slots.size());
+        m_slots.emplace_back();
+    }
+
+    Slot& slot = m_slots[handle];
+    slot.alive = true;
+    slot.instance = Instance{
+        &texture,
+        source,
+        Rectangle{ x, y, static_cast<float>(source.w), static_cast<float>(source.h) },
+        m_nextOrder++
+    };
+    link(handle);
+
+    m_count++;
+    m_sizeSum += std::max(source.w, source.h);
+    retuneIfNeeded();
+    return handle;
+}
+
+void Scene::move(Handle handle, float x, float y) {
+    if (!contains(handle)) {
+        throw std::runtime_error("Invalid scene handle");
+    }
+    Slot& slot = m_slots[handle];
+    Rectangle bounds = slot.instance.bounds;
+    bounds.x = x;
+    bounds.y = y;
+
+    // Most moves stay inside the same cells
+    CellRange range = cellsFor(bounds);
+    if (!slot.oversized && range.minX == slot.minX && range.minY == slot.minY
+        && range.maxX == slot.maxX && range.maxY == slot.maxY) {
+        slot.instance.bounds = bounds;
+        return;
+    }
+
+    unlink(handle);
+    slot.instance.bounds = bounds;
+    link(handle);
+}
+
+void Scene::remove(Handle handle) {
+    if (!contains(handle)) {
+        return;
+    }
+    unlink(handle);
+    Slot& slot = m_slots[handle];
+    slot.alive = false;
+    m_sizeSum -= std::max(slot.instance.source.w, slot.instance.source.h);
+    m_free.push_back(handle);
+    m_count--;
+    retuneIfNeeded();
+}
+
+void Scene::clear() {
+    m_slots.clear();
+    m_free.clear();
+    m_cells.clear();
+    m_oversized.clear();
+    m_count = 0;
+    m_sizeSum = 0.0;
+    m_countAtLastTune = 0;
+}
+
+bool Scene::contains(Handle handle) const {
+    return handle < m_slots.size() && m_slots[handle].alive;
+}
+
+const Scene::Instance& Scene::get(Handle handle) const {
+    if (!contains(handle)) {
+        throw std::runtime_error("Invalid scene handle");
+    }
+    return m_slots[handle].instance;
+}
+
+void Scene::retuneIfNeeded() {
+    if (!m_autoCellSize || m_count < kMinTuneCount) {
+        return;
+    }
+    // Only reconsider after the population has doubled or halved
+    if (m_count < m_countAtLastTune * 2 && m_count * 2 > m_countAtLastTune) {
+        return;
+    }
+    m_countAtLastTune = m_count;
+
+    // Cells about twice the typical object size keep most objects in one to
+    // four cells without making cells crowded
+    float average = static_cast<float>(m_sizeSum / m_count);
+    float desired = std::min(kMaxCellSize, std::max(kMinCellSize, average * 2.0f));
+    if (desired > m_cellSize * 2.0f || desired < m_cellSize * 0.5f) {
+        rebuild(desired);
+    }
+}
+
+void Scene::rebuild(float cellSize) {
+    m_cellSize = cellSize;
+    m_cells.clear();
+    m_oversized.clear();
+    for (Handle handle = 0; handle < m_slots.size(); ++handle) {
+        if (m_slots[handle].alive) {
+            link(handle);
+        }
+    }
+    m_stats.rebuilds++;
+}
+
+void Scene::query(const Rectangle& area, std::vector<Handle>& out) const {
+    out.clear();
+    m_stats.lastCandidates = 0;
+
+    if (m_visited.size() < m_slots.size()) {
+        m_visited.resize(m_slots.size(), 0);
+    }
+    if (++m_queryStamp == 0) {
+        std::fill(m_visited.begin(), m_visited.end(), 0);
+        m_queryStamp = 1;
+    }
+
+    auto consider = [&](Handle handle) {
+        if (m_visited[handle] == m_queryStamp) return;
+        m_visited[handle] = m_queryStamp;
+        m_stats.lastCandidates++;
+        if (m_slots[handle].instance.bounds.intersects(area)) {
+            out.push_back(handle);
+        }
+    };
+
+    if (!area.isEmpty()) {
+        CellRange range = cellsFor(area);
+        double cellsInRange = static_cast<double>(range.maxX - range.minX + 1) * (range.maxY - range.minY + 1);
+
+        if (cellsInRange <= static_cast<double>(m_cells.size())) {
+            for (int y = range.minY; y <= range.maxY; ++y) {
+                for (int x = range.minX; x <= range.maxX; ++x) {
+                    auto cell = m_cells.find(cellKey(x, y));
+                    if (cell == m_cells.end()) continue;
+                    for (Handle handle : cell->second) {
+                        consider(handle);
+                    }
+                }
+            }
+        } else {
+            // Zoomed far out: walking the occupied cells is cheaper
+            for (const auto& cell : m_cells) {
+                int x = static_cast<int>(static_cast<int32_t>(cell.first >> 32));
+                int y = static_cast<int>(static_cast<int32_t>(cell.first & 0xFFFFFFFFu));
+                if (x < range.minX || x > range.maxX || y < range.minY || y > range.maxY) continue;
+                for (Handle handle : cell.second) {
+                    consider(handle);
+                }
+            }
+        }
+
+        for (Handle handle : m_oversized) {
+            consider(handle);
+        }
+    }
+
+    std::sort(out.begin(), out.end(), [this](Handle a, Handle b) {
+        return m_slots[a].instance.order < m_slots[b].instance.order;
+    });
+
+    m_stats.objects = m_count;
+    m_stats.occupiedCells = m_cells.size();
+    m_stats.oversized = m_oversized.size();
+    m_stats.cellSize = m_cellSize;
+    m_stats.lastVisible = out.size();
+}
+
+void Scene::render(Graphics& graphics, const Camera& camera, BlendMode mode) {
+    // Like Texture's culling, fall back to the renderer's viewport
+    if (camera.hasViewport()) {
+        query(camera.visibleWorldRect(), m_visible);
+    } else {
+        SDL_Rect viewport;
+        SDL_RenderGetViewport(graphics.getRenderer(), &viewport);
+        const Rectangle screen = {
+            0.0f, 0.0f, static_cast<float>(viewport.w), static_cast<float>(viewport.h)
+        };
+        query(camera.visibleWorldRect(screen), m_visible);
+    }
+
+    for (Handle handle : m_visible) {
+        const Instance& instance = m_slots[handle].instance;
+        instance.texture->render(instance.source, instance.bounds.x, instance.bounds.y, &camera, mode);
+    }
+}
@@ -0,0 +1,105 @@
+// scene.hpp
+#pragma once
+#include <SDL2/SDL.h>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "geometry.hpp"
+#include "texture.hpp"
+
+class Camera;
+class Graphics;
+
+// Placed Texture instances indexed by their world rects. Backed by a hashed
+// uniform grid whose cell size follows the average object size; objects much
+// larger than a cell are kept in a separate list that every query checks.
+// Query cost follows the number of cells the area covers and the objects
+// in them, not the size of the scene.
+class Scene {
+public:
+    using Handle = uint32_t;
+
+    struct Instance {
+        Texture* texture;
+        SDL_Rect source;        // Region of the texture that is drawn
+        Rectangle bounds;       // World-space rect, same size as source
+        uint64_t order;         // Draw order, increasing with insertion
+    };
+
+    struct Stats {
+        size_t objects = 0;
+        size_t occupiedCells = 0;
+        size_t oversized = 0;
+        float cellSize = 0.0f;
+        int rebuilds = 0;
+        size_t lastCandidates = 0;  // Objects examined by the last query
+        size_t lastVisible = 0;     // Objects returned by the last query
+    };
+
+    // A cellSize of 0 lets the scene pick and retune it from object sizes
+    explicit Scene(float cellSize = 0.0f);
+
+    // Prevent copying
+    Scene(const Scene&) = delete;
+    Scene& operator=(const Scene&) = delete;
+
+    // Places the whole texture, or a region of it, with its top-left at (x, y)
+    Handle insert(Texture& texture, float x, float y);
+    Handle insert(Texture& texture, const SDL_Rect& source, float x, float y);
+
+    void move(Handle handle, float x, float y);
+    void remove(Handle handle);
+    void clear();
+
+    bool contains(Handle handle) const;
+    const Instance& get(Handle handle) const;
+    size_t size() const { return m_count; }
+
+    // Handles of every instance overlapping area, in draw order
+    void query(const Rectangle& area, std::vector<Handle>& out) const;
+
+    // Draws every instance inside the camera's visible world rect, at its
+    // sub-pixel position. Without a camera viewport the renderer's is used.
+    void render(Graphics& graphics, const Camera& camera, BlendMode mode = BlendMode::Alpha);
+
+    const Stats& getStats() const { return m_stats; }
+
+private:
+    struct Slot {
+        Instance instance;
+        bool alive = false;
+        bool oversized = false;
+        int minX, minY, maxX, maxY;     // Cell range the instance is filed under
+    };
+
+    struct CellRange {
+        int minX, minY, maxX, maxY;
+    };
+
+    static uint64_t cellKey(int x, int y) {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(y);
+    }
+
+    CellRange cellsFor(const Rectangle& bounds) const;
+    void link(Handle handle);
+    void unlink(Handle handle);
+    void retuneIfNeeded();
+    void rebuild(float cellSize);
+
+    bool m_autoCellSize;
+    float m_cellSize;
+    std::vector<Slot> m_slots;
+    std::vector<Handle> m_free;
+    std::unordered_map<uint64_t, std::vector<Handle>> m_cells;
+    std::vector<Handle> m_oversized;
+    size_t m_count = 0;
+    uint64_t m_nextOrder = 0;
+    double m_sizeSum = 0.0;             // Sum of max(width, height) over live instances
+    size_t m_countAtLastTune = 0;
+
+    // Per-query dedup marks for instances spanning several cells
+    mutable std::vector<uint32_t> m_visited;
+    mutable uint32_t m_queryStamp = 0;
+    mutable Stats m_stats;
+    std::vector<Handle> m_visible;      // Reused by render()
+};
@@ -0,0 +1,100 @@
+// stroke_buffer.cpp
+#include "stroke_buffer.hpp"
+#include "graphics.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+StrokeBuffer::StrokeBuffer(Graphics& graphics, Texture& canvas)
+    : m_graphics(graphics)
+    , m_canvas(canvas)
+{
+}
+
+StrokeBuffer::~StrokeBuffer() = default;
+
+void StrokeBuffer::prepare() {
+    const int width = m_canvas.getWidth();
+    const int height = m_canvas.getHeight();
+    if (!m_buffer || m_buffer->getWidth() != width || m_buffer->getHeight() != height) {
+        m_buffer = std::make_unique<Texture>(Texture::create(m_graphics, width, height));
+        m_buffer->clear(0, 0, 0, 0);
+    } else if (!SDL_RectEmpty(&m_stale)) {
+        m_buffer->clear(m_stale, 0, 0, 0, 0);
+    }
+    m_stale = SDL_Rect{ 0, 0, 0, 0 };
+}
+
+void StrokeBuffer::begin(float opacity, BlendMode mode) {
+    if (m_active) {
+        end();
+    }
+    prepare();
+
+    m_opacity = std::min(1.0f, std::max(0.0f, opacity));
+    m_mode = mode;
+    m_bounds = SDL_Rect{ 0, 0, 0, 0 };
+    m_stats.stamps = 0;
+    m_active = true;
+}
+
+void StrokeBuffer::stamp(Texture& brush, const StampPlacement& placement, const DrawParams& params) {
+    stamp(brush, SDL_Rect{ 0, 0, brush.getWidth(), brush.getHeight() }, placement, params);
+}
+
+void StrokeBuffer::stamp(Texture& brush, const SDL_Rect& source, const StampPlacement& placement,
+                         const DrawParams& params) {
+    if (!m_active) {
+        throw std::runtime_error("StrokeBuffer::stamp called outside a stroke");
+    }
+
+    DrawParams accumulate = params;
+    accumulate.blendMode = BlendMode::MaxAlpha;
+    const SDL_Rect touched = brush.stamp(*m_buffer, source, placement, accumulate);
+    if (!SDL_RectEmpty(&touched)) {
+        SDL_UnionRect(&m_bounds, &touched, &m_bounds);
+    }
+    m_stats.stamps++;
+}
+
+void StrokeBuffer::renderPreview(int x, int y, const Camera* camera) {
+    if (!m_active || SDL_RectEmpty(&m_bounds)) {
+        return;
+    }
+
+    DrawParams params;
+    params.opacity = m_opacity;
+    params.blendMode = m_mode;
+    m_buffer->render(m_bounds.x, m_bounds.y, m_bounds.w, m_bounds.h,
+                     x + m_bounds.x, y + m_bounds.y, camera, params);
+}
+
+SDL_Rect StrokeBuffer::end() {
+    if (!m_active) {
+        return SDL_Rect{ 0, 0, 0, 0 };
+    }
+    m_active = false;
+
+    const SDL_Rect area = m_bounds;
+    if (!SDL_RectEmpty(&area)) {
+        // The one blend of this stroke into the canvas
+        DrawParams params;
+        params.opacity = m_opacity;
+        params.blendMode = m_mode;
+        m_buffer->render(m_canvas, area.x, area.y, area.w, area.h, area.x, area.y, params);
+
+        m_stats.strokes++;
+        m_stats.pixelsComposited = static_cast<long>(area.w) * area.h;
+    }
+
+    m_stale = area;
+    m_bounds = SDL_Rect{ 0, 0, 0, 0 };
+    return area;
+}
+
+void StrokeBuffer::cancel() {
+    if (m_active) {
+        m_active = false;
+        m_stale = m_bounds;
+        m_bounds = SDL_Rect{ 0, 0, 0, 0 };
+    }
+}
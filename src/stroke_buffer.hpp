@@ -0,0 +1,74 @@
+// stroke_buffer.hpp
+#pragma once
+#include <SDL2/SDL.h>
+#include <memory>
+#include "texture.hpp"
+
+class Graphics;
+class Camera;
+
+// Collects one brush stroke off the canvas so it is blended into the canvas
+// once, when the stroke ends, instead of once per stamp. Stamps combine with
+// MaxAlpha: color composites over as usual, but alpha keeps the strongest
+// coverage where stamps overlap instead of building up, and the stroke's
+// opacity caps the whole stroke.
+//
+// The buffer is canvas sized and kept between strokes, but clearing,
+// previewing and compositing only touch the stroke's bounding box, which
+// grows with each stamp.
+class StrokeBuffer {
+public:
+    struct Stats {
+        int strokes = 0;            // Strokes composited into the canvas
+        int stamps = 0;             // Stamps in the current or last stroke
+        long pixelsComposited = 0;  // Area the last stroke composited
+    };
+
+    StrokeBuffer(Graphics& graphics, Texture& canvas);
+    ~StrokeBuffer();
+
+    // Prevent copying
+    StrokeBuffer(const StrokeBuffer&) = delete;
+    StrokeBuffer& operator=(const StrokeBuffer&) = delete;
+
+    // Starts a stroke that will be composited with opacity and mode. Ends
+    // any stroke already in progress first.
+    void begin(float opacity = 1.0f, BlendMode mode = BlendMode::Alpha);
+
+    // Adds a stamp in canvas coordinates. params.opacity acts as flow: it
+    // limits this stamp without adding up across overlapping ones. The
+    // blend mode in params is ignored.
+    void stamp(Texture& brush, const StampPlacement& placement, const DrawParams& params = DrawParams());
+    void stamp(Texture& brush, const SDL_Rect& source, const StampPlacement& placement,
+               const DrawParams& params = DrawParams());
+
+    // Draws the stroke so far over the canvas as the canvas would look
+    // with it composited, for a canvas drawn at x, y (world coordinates
+    // when there is a camera)
+    void renderPreview(int x, int y, const Camera* camera = nullptr);
+
+    // Composites the stroke into the canvas and returns the area changed
+    SDL_Rect end();
+
+    // Drops the stroke without touching the canvas
+    void cancel();
+
+    bool isActive() const { return m_active; }
+    const SDL_Rect& getBounds() const { return m_bounds; }
+    const Stats& getStats() const { return m_stats; }
+
+private:
+    // Creates the buffer on first use or when the canvas was resized, and
+    // clears what the previous stroke left behind
+    void prepare();
+
+    Graphics& m_graphics;
+    Texture& m_canvas;
+    std::unique_ptr<Texture> m_buffer;
+    float m_opacity = 1.0f;
+    BlendMode m_mode = BlendMode::Alpha;
+    bool m_active = false;
+    SDL_Rect m_bounds = { 0, 0, 0, 0 };     // Covered by the current stroke
+    SDL_Rect m_stale = { 0, 0, 0, 0 };      // Left by the previous stroke; cleared on begin()
+    Stats m_stats;
+};
@@ -1,53 +1,100 @@
 // texture.cpp
 #include "texture.hpp"
 #include "graphics.hpp"
+#include "pixel_convert.hpp"
+#include "decoded_cache.hpp"
+#include "file_util.hpp"
+#include "qoi.hpp"
+#include "frame_arena.hpp"
+#include "flood_fill.hpp"
+#include "filter.hpp"
+#include "thread_pool.hpp"
 #include <SDL2/SDL_image.h>
 #include <stdexcept>
 #include <iostream>
 #include <vector>
+#include <cstring>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
 
 Texture::Texture(Graphics& graphics)
     : m_graphics(graphics)
     , m_texture(nullptr)
     , m_width(0)
     , m_height(0)
+    , m_premultiplied(graphics.usesPremultipliedAlpha())
 {
 }
 
 Texture::Texture(Texture&& other) noexcept
     : m_graphics(other.m_graphics)
     , m_texture(other.m_texture)
+    , m_surface(other.m_surface)
     , m_width(other.m_width)
     , m_height(other.m_height)
+    , m_premultiplied(other.m_premultiplied)
+    , m_stream(std::move(other.m_stream))
 {
     other.m_texture = nullptr;  // Prevent double deletion
+    other.m_surface = nullptr;
     other.m_width = 0;
     other.m_height = 0;
 }
 
 Texture::~Texture() {
     if (m_texture) {
+        // Queued quads may still reference this texture
+        m_graphics.flushBatch();
         SDL_DestroyTexture(m_texture);
     }
+    if (m_surface) {
+        SDL_FreeSurface(m_surface);
+    }
+    if (m_stream && m_stream->back) {
+        SDL_DestroyTexture(m_stream->back);
+    }
 }
 
 Texture& Texture::operator=(Texture&& other) noexcept {
     if (this != &other) {
         if (m_texture) {
+            m_graphics.flushBatch();
             SDL_DestroyTexture(m_texture);
         }
+        if (m_surface) {
+            SDL_FreeSurface(m_surface);
+        }
+        if (m_stream && m_stream->back) {
+            SDL_DestroyTexture(m_stream->back);
+        }
         
         m_texture = other.m_texture;
+        m_surface = other.m_surface;
+        m_stream = std::move(other.m_stream);
         m_width = other.m_width;
         m_height = other.m_height;
+        m_premultiplied = other.m_premultiplied;
         
         other.m_texture = nullptr;
+        other.m_surface = nullptr;
         other.m_width = 0;
         other.m_height = 0;
     }
     return *this;
 }
 
+void Texture::checkSize(Graphics& graphics, int width, int height) {
+    const Graphics::Capabilities& caps = graphics.getCapabilities();
+    if ((caps.maxTextureWidth > 0 && width > caps.maxTextureWidth)
+        || (caps.maxTextureHeight > 0 && height > caps.maxTextureHeight)) {
+        throw std::runtime_error("Texture size " + std::to_string(width) + "x" + std::to_string(height)
+                                 + " exceeds the renderer limit of "
+                                 + std::to_string(caps.maxTextureWidth) + "x"
+                                 + std::to_string(caps.maxTextureHeight));
+    }
+}
+
 Texture Texture::create(Graphics& graphics, int width, int height) {
     Texture texture(graphics);
     
@@ -55,9 +102,14 @@ Texture Texture::create(Graphics& graphics, int width, int height) {
     // Set SDL_HINT_RENDER_SCALE_QUALITY to best (2)
     SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "2");
 
+    if (!graphics.getCapabilities().supportsTargets) {
+        throw std::runtime_error("Renderer does not support render targets");
+    }
+    checkSize(graphics, width, height);
+
     texture.m_texture = SDL_CreateTexture(
         graphics.getRenderer(),
-        SDL_PIXELFORMAT_RGBA8888,
+        graphics.getNativeFormat(),
         SDL_TEXTUREACCESS_TARGET,
         width, height
     );
@@ -67,7 +119,7 @@ Texture Texture::create(Graphics& graphics, int width, int height) {
     }
 
     // Enable alpha blending
-    SDL_SetTextureBlendMode(texture.m_texture, SDL_BLENDMODE_BLEND);
+    SDL_SetTextureBlendMode(texture.m_texture, toSDLBlendMode(BlendMode::Alpha, texture.m_premultiplied));
     
     texture.m_width = width;
     texture.m_height = height;
@@ -76,63 +128,253 @@ Texture Texture::create(Graphics& graphics, int width, int height) {
 }
 
 Texture Texture::create(Graphics& graphics, const std::string& path, bool makeTarget) {
-    Texture texture(graphics);
+    // Step 1: Decode straight to the renderer's native format so the upload
+    // is a plain copy, premultiplying during the same pass if needed
+    bool converted = false;
+    SDL_Surface* surface = decodeFile(path, graphics.getNativeFormat(), &converted,
+                                      graphics.usesPremultipliedAlpha());
+    if (converted) {
+        graphics.frameStats().formatConversions++;
+    }
+    try {
+        checkSize(graphics, surface->w, surface->h);
+    } catch (...) {
+        SDL_FreeSurface(surface);
+        throw;
+    }
+
+    // Step 2: Upload
+    return upload(graphics, surface, makeTarget, surface->pixels, surface->pitch);
+}
+
+SDL_Surface* Texture::decodeFile(const std::string& path, Uint32 format, bool* converted, bool premultiply) {
+    if (converted) {
+        *converted = false;
+    }
 
-    // Step 1: Load from file normally to preserve alpha
-    texture.m_surface = IMG_Load(path.c_str());
-    if (!texture.m_surface) {
+    // Fast snapshots are decoded from a mapping of the file
+    {
+        MappedFile file(path);
+        if (file.isOpen() && Qoi::isQoi(file.data(), file.size())) {
+            SDL_Surface* surface = Qoi::decode(file.data(), file.size(), format);
+            if (!surface) {
+                throw std::runtime_error("Failed to load image: " + std::string(SDL_GetError()));
+            }
+            if (converted) {
+                *converted = format != SDL_PIXELFORMAT_RGBA32;
+            }
+            if (premultiply) {
+                PixelConvert::premultiply(surface->pixels, surface->pitch, format, surface->w, surface->h);
+            }
+            return surface;
+        }
+    }
+
+    // Load from file normally to preserve alpha
+    SDL_Surface* loaded = IMG_Load(path.c_str());
+    if (!loaded) {
         throw std::runtime_error("Failed to load image: " + std::string(IMG_GetError()));
     }
 
-    if (!makeTarget) {
-        // For non-render targets, just create directly from surface
-        texture.m_texture = SDL_CreateTextureFromSurface(graphics.getRenderer(), texture.m_surface);
-        if (!texture.m_texture) {
-            throw std::runtime_error("Failed to create texture: " + std::string(SDL_GetError()));
+    // Convert once; a color key becomes alpha during this conversion
+    if (loaded->format->format == format && !SDL_HasColorKey(loaded)) {
+        if (premultiply) {
+            PixelConvert::premultiply(loaded->pixels, loaded->pitch, format, loaded->w, loaded->h);
         }
-    } else {
-        // For render targets, create temp texture then copy to target
-        SDL_Texture* tempTexture = SDL_CreateTextureFromSurface(graphics.getRenderer(), texture.m_surface);
-        if (!tempTexture) {
-            throw std::runtime_error("Failed to create temp texture: " + std::string(SDL_GetError()));
+        return loaded;
+    }
+    SDL_Surface* surface = PixelConvert::convertSurface(loaded, format, premultiply);
+    SDL_FreeSurface(loaded);
+    if (!surface) {
+        throw std::runtime_error("Failed to convert image: " + std::string(SDL_GetError()));
+    }
+    if (converted) {
+        *converted = true;
+    }
+    return surface;
+}
+
+Texture Texture::create(Graphics& graphics, const std::string& path, DecodedCache& cache, bool makeTarget) {
+    const bool premultiply = graphics.usesPremultipliedAlpha();
+    DecodedImage image;
+    if (!cache.lookup(path, graphics.getNativeFormat(), image)) {
+        if (!premultiply) {
+            Texture texture = create(graphics, path, makeTarget);
+            cache.store(path, texture.m_surface);
+            return texture;
+        }
+
+        // The cache holds straight alpha so it serves both modes; store
+        // before premultiplying
+        bool converted = false;
+        SDL_Surface* surface = decodeFile(path, graphics.getNativeFormat(), &converted);
+        if (converted) {
+            graphics.frameStats().formatConversions++;
+        }
+        try {
+            checkSize(graphics, surface->w, surface->h);
+        } catch (...) {
+            SDL_FreeSurface(surface);
+            throw;
         }
+        cache.store(path, surface);
+        PixelConvert::premultiply(surface->pixels, surface->pitch, surface->format->format, surface->w, surface->h);
+        return upload(graphics, surface, makeTarget, surface->pixels, surface->pitch);
+    }
+    checkSize(graphics, image.width, image.height);
+
+    // Keep a CPU copy for getPixel(); the upload itself reads the mapping
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, image.width, image.height, 32, graphics.getNativeFormat());
+    if (!surface) {
+        throw std::runtime_error("Failed to create surface: " + std::string(SDL_GetError()));
+    }
+    for (int y = 0; y < image.height; ++y) {
+        std::memcpy(static_cast<uint8_t*>(surface->pixels) + static_cast<size_t>(y) * surface->pitch,
+                    static_cast<const uint8_t*>(image.pixels) + static_cast<size_t>(y) * image.pitch,
+                    static_cast<size_t>(image.width) * 4);
+    }
+
+    // The mapping holds straight alpha, so a premultiplied texture uploads
+    // its own converted copy instead
+    if (premultiply) {
+        PixelConvert::premultiply(surface->pixels, surface->pitch, surface->format->format, surface->w, surface->h);
+        return upload(graphics, surface, makeTarget, surface->pixels, surface->pitch);
+    }
+    return upload(graphics, surface, makeTarget, image.pixels, image.pitch);
+}
+
+Texture Texture::upload(Graphics& graphics, SDL_Surface* surface, bool makeTarget,
+                        const void* pixels, int pitch) {
+    Texture texture(graphics);
+    texture.m_surface = surface;
+
+    // Render targets can be updated directly, so no temporary texture is
+    // needed for them either
+    if (makeTarget && !graphics.getCapabilities().supportsTargets) {
+        throw std::runtime_error("Renderer does not support render targets");
+    }
+    texture.m_texture = SDL_CreateTexture(
+        graphics.getRenderer(),
+        surface->format->format,
+        makeTarget ? SDL_TEXTUREACCESS_TARGET : SDL_TEXTUREACCESS_STATIC,
+        surface->w,
+        surface->h
+    );
+    if (!texture.m_texture) {
+        throw std::runtime_error("Failed to create texture: " + std::string(SDL_GetError()));
+    }
+    if (SDL_UpdateTexture(texture.m_texture, nullptr, pixels, pitch) != 0) {
+        throw std::runtime_error("Failed to upload texture: " + std::string(SDL_GetError()));
+    }
+
+    texture.m_width = surface->w;
+    texture.m_height = surface->h;
+    SDL_SetTextureBlendMode(texture.m_texture, toSDLBlendMode(BlendMode::Alpha, texture.m_premultiplied));
 
-        // Create the target texture
-        texture.m_texture = SDL_CreateTexture(
+    return texture;
+}
+
+
+Texture Texture::createStreaming(Graphics& graphics, int width, int height) {
+    Texture texture(graphics);
+    checkSize(graphics, width, height);
+
+    auto stream = std::make_unique<StreamingState>();
+    for (SDL_Texture** slot : { &texture.m_texture, &stream->back }) {
+        *slot = SDL_CreateTexture(
             graphics.getRenderer(),
-            SDL_PIXELFORMAT_RGBA8888,
-            SDL_TEXTUREACCESS_TARGET,
-            texture.m_surface->w,
-            texture.m_surface->h
+            graphics.getNativeFormat(),
+            SDL_TEXTUREACCESS_STREAMING,
+            width, height
         );
-        if (!texture.m_texture) {
-            SDL_DestroyTexture(tempTexture);
-            throw std::runtime_error("Failed to create target texture: " + std::string(SDL_GetError()));
+        if (!*slot) {
+            // If the back buffer failed, ~Texture still releases the front one
+            throw std::runtime_error("Failed to create streaming texture: " + std::string(SDL_GetError()));
         }
+        SDL_SetTextureBlendMode(*slot, toSDLBlendMode(BlendMode::Alpha, texture.m_premultiplied));
+    }
+
+    stream->staging.assign(static_cast<size_t>(width) * height, 0);
+    texture.m_stream = std::move(stream);
+    texture.m_width = width;
+    texture.m_height = height;
 
-        // Copy temp texture to target
-        SDL_SetRenderTarget(graphics.getRenderer(), texture.m_texture);
-        SDL_RenderCopy(graphics.getRenderer(), tempTexture, nullptr, nullptr);
-        SDL_SetRenderTarget(graphics.getRenderer(), nullptr);
+    // Start both buffers transparent
+    texture.lock();
+    texture.unlock();
+    texture.lock();
+    texture.unlock();
 
-        // Clean up temp texture
-        SDL_DestroyTexture(tempTexture);
+    return texture;
+}
+
+PixelSpan Texture::lock(const SDL_Rect* rect) {
+    if (!m_stream) {
+        throw std::runtime_error("Only streaming textures can be locked");
+    }
+    if (m_stream->isLocked) {
+        throw std::runtime_error("Texture is already locked");
+    }
+
+    SDL_Rect full = { 0, 0, m_width, m_height };
+    SDL_Rect region = full;
+    if (rect && !SDL_IntersectRect(rect, &full, &region)) {
+        region = { 0, 0, 0, 0 };
     }
 
-    texture.m_width = texture.m_surface->w;
-    texture.m_height = texture.m_surface->h;
-    SDL_SetTextureBlendMode(texture.m_texture, SDL_BLENDMODE_BLEND);
+    m_stream->locked = region;
+    m_stream->isLocked = true;
 
-    return texture;
+    // Writes land in the staging copy, which SDL never touches, so this is
+    // safe while the GPU is still drawing either SDL texture
+    uint32_t* origin = m_stream->staging.data() + static_cast<size_t>(region.y) * m_width + region.x;
+    return PixelSpan{ origin, m_width, region.w, region.h };
 }
 
+void Texture::unlock() {
+    if (!m_stream || !m_stream->isLocked) {
+        return;
+    }
+    m_stream->isLocked = false;
+
+    const SDL_Rect& written = m_stream->locked;
+    if (SDL_RectEmpty(&written)) {
+        return;
+    }
+    SDL_UnionRect(&m_stream->frontPending, &written, &m_stream->frontPending);
+    SDL_UnionRect(&m_stream->backPending, &written, &m_stream->backPending);
+
+    // Quads queued against the current front buffer must draw before the swap
+    m_graphics.flushBatch();
+
+    // Bring the back buffer up to date with everything written since its
+    // last upload, then make it the one that gets drawn
+    const SDL_Rect& upload = m_stream->backPending;
+    void* pixels = nullptr;
+    int pitch = 0;
+    if (SDL_LockTexture(m_stream->back, &upload, &pixels, &pitch) != 0) {
+        throw std::runtime_error("Failed to lock streaming texture: " + std::string(SDL_GetError()));
+    }
+    for (int y = 0; y < upload.h; ++y) {
+        const uint32_t* source = m_stream->staging.data() + static_cast<size_t>(upload.y + y) * m_width + upload.x;
+        std::memcpy(static_cast<uint8_t*>(pixels) + static_cast<size_t>(y) * pitch, source, upload.w * sizeof(uint32_t));
+    }
+    SDL_UnlockTexture(m_stream->back);
+    m_stream->backPending = { 0, 0, 0, 0 };
+
+    std::swap(m_texture, m_stream->back);
+    std::swap(m_stream->frontPending, m_stream->backPending);
+}
 
 void Texture::draw(int x, int y) {
+    m_graphics.flushBatch();
     SDL_Rect destRect = { x, y, m_width, m_height };
     SDL_RenderCopy(m_graphics.getRenderer(), m_texture, nullptr, &destRect);
 }
 
 void Texture::draw(Texture& target, int x, int y) {
+    m_graphics.flushBatch();
+
     // Store current render target
     SDL_Texture* previousTarget = SDL_GetRenderTarget(m_graphics.getRenderer());
     
@@ -148,26 +390,25 @@ void Texture::draw(Texture& target, int x, int y) {
 }
 
 void Texture::resize(int width, int height, ScaleMode mode) {
-    // Create a surface from the current texture
-    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(
-        0, m_width, m_height, 32, SDL_PIXELFORMAT_RGBA8888
-    );
+    if (m_stream) {
+        throw std::runtime_error("Streaming textures cannot be resized");
+    }
+    checkSize(m_graphics, width, height);
+    m_graphics.flushBatch();
+
+    // Work in the native format so neither the readback nor the upload converts
+    const Uint32 format = m_graphics.getNativeFormat();
+    FrameArena& arena = m_graphics.frameArena();
+
+    // Scratch surface for the current pixels (blending is off on arena surfaces)
+    SDL_Surface* surface = arena.surface(m_width, m_height);
     if (!surface) {
         throw std::runtime_error("Failed to create surface: " + std::string(SDL_GetError()));
     }
 
-    // Set blending mode on surface to NONE (no blending during pixel operations)
-    SDL_SetSurfaceBlendMode(surface, SDL_BLENDMODE_NONE);
-
-    // Create temporary texture and read pixels into surface
-    SDL_Texture* target = SDL_CreateTexture(
-        m_graphics.getRenderer(),
-        SDL_PIXELFORMAT_RGBA8888,
-        SDL_TEXTUREACCESS_TARGET,
-        m_width, m_height
-    );
+    // Temporary target to read pixels from
+    SDL_Texture* target = arena.renderTarget(m_width, m_height);
     if (!target) {
-        SDL_FreeSurface(surface);
         throw std::runtime_error("Failed to create target: " + std::string(SDL_GetError()));
     }
 
@@ -193,64 +434,46 @@ void Texture::resize(int width, int height, ScaleMode mode) {
     // Read pixels into surface
     SDL_RenderReadPixels(
         m_graphics.getRenderer(), nullptr,
-        SDL_PIXELFORMAT_RGBA8888,
+        format,
         surface->pixels, surface->pitch
     );
 
     // Restore render target
     SDL_SetRenderTarget(m_graphics.getRenderer(), previousTarget);
-    SDL_DestroyTexture(target);
 
-    // Create scaled surface
-    SDL_Surface* scaledSurface = SDL_CreateRGBSurfaceWithFormat(
-        0, width, height, 32, SDL_PIXELFORMAT_RGBA8888
-    );
+    // Scratch surface for the scaled pixels
+    SDL_Surface* scaledSurface = arena.surface(width, height);
     if (!scaledSurface) {
-        SDL_FreeSurface(surface);
         throw std::runtime_error("Failed to create scaled surface: " + std::string(SDL_GetError()));
     }
 
-    // Set blending mode on the scaled surface to NONE
-    SDL_SetSurfaceBlendMode(scaledSurface, SDL_BLENDMODE_NONE);
-
     // Scale the surface
     SDL_BlitScaled(surface, nullptr, scaledSurface, nullptr);
 
-    // Create new texture from scaled surface
-//    SDL_Texture* newTexture = SDL_CreateTextureFromSurface(m_graphics.getRenderer(), scaledSurface);
-//    if (!newTexture) {
-//        SDL_FreeSurface(surface);
-//        SDL_FreeSurface(scaledSurface);
-//        throw std::runtime_error("Failed to create new texture: " + std::string(SDL_GetError()));
-//    }
-
-    SDL_Texture* newTexture = SDL_CreateTexture(
-        m_graphics.getRenderer(),
-        SDL_PIXELFORMAT_RGBA8888,
-        SDL_TEXTUREACCESS_TARGET,
-        width, height
-    );
+    // The new texture comes from the arena's pool, and the old one goes back
+    // to it, so resizing back and forth doesn't create textures
+    SDL_Texture* newTexture = arena.takeTarget(width, height);
     if (!newTexture) {
-        SDL_FreeSurface(surface);
-        SDL_FreeSurface(scaledSurface);
         throw std::runtime_error("Failed to create new texture: " + std::string(SDL_GetError()));
     }
 
-    // Set it as render target and copy the scaled surface data to it
-    SDL_SetRenderTarget(m_graphics.getRenderer(), newTexture);
-    SDL_Texture* tempTexture = SDL_CreateTextureFromSurface(m_graphics.getRenderer(), scaledSurface);
-    SDL_RenderCopy(m_graphics.getRenderer(), tempTexture, nullptr, nullptr);
-    SDL_DestroyTexture(tempTexture);
-    SDL_SetRenderTarget(m_graphics.getRenderer(), nullptr);
-
-
-    // Set blend mode on new texture
-    SDL_SetTextureBlendMode(newTexture, SDL_BLENDMODE_BLEND);
+    // Upload the scaled pixels; the formats match, so this is a straight copy
+    SDL_UpdateTexture(newTexture, nullptr, scaledSurface->pixels, scaledSurface->pitch);
+    SDL_SetTextureBlendMode(newTexture, toSDLBlendMode(BlendMode::Alpha, m_premultiplied));
+
+    // The CPU copy getPixel() reads follows the new size; the scaled
+    // surface goes back to the arena, so keep a copy
+    if (m_surface) {
+        SDL_Surface* copy = SDL_DuplicateSurface(scaledSurface);
+        if (!copy) {
+            arena.adoptTarget(newTexture);
+            throw std::runtime_error("Failed to copy scaled surface: " + std::string(SDL_GetError()));
+        }
+        SDL_FreeSurface(m_surface);
+        m_surface = copy;
+    }
 
-    // Clean up
-    SDL_FreeSurface(surface);
-    SDL_FreeSurface(scaledSurface);
-    SDL_DestroyTexture(m_texture);
+    arena.adoptTarget(m_texture);
 
     // Update member variables
     m_texture = newTexture;
@@ -259,29 +482,181 @@ void Texture::resize(int width, int height, ScaleMode mode) {
 }
 
 
+void Texture::replacePixels(SDL_Surface* surface) {
+    if (m_stream) {
+        SDL_FreeSurface(surface);
+        throw std::runtime_error("Streaming textures are updated through lock()");
+    }
+    if (surface->format->format != m_graphics.getNativeFormat()) {
+        SDL_FreeSurface(surface);
+        throw std::runtime_error("Replacement pixels must be in the native format");
+    }
+    try {
+        checkSize(m_graphics, surface->w, surface->h);
+    } catch (...) {
+        SDL_FreeSurface(surface);
+        throw;
+    }
+    m_graphics.flushBatch();
+
+    if (m_premultiplied) {
+        PixelConvert::premultiply(surface->pixels, surface->pitch, surface->format->format, surface->w, surface->h);
+    }
+
+    // A new size needs a new SDL texture with the same access and blend mode
+    if (surface->w != m_width || surface->h != m_height) {
+        int access = SDL_TEXTUREACCESS_STATIC;
+        SDL_QueryTexture(m_texture, nullptr, &access, nullptr, nullptr);
+        SDL_Texture* replacement = SDL_CreateTexture(
+            m_graphics.getRenderer(),
+            surface->format->format,
+            access,
+            surface->w, surface->h
+        );
+        if (!replacement) {
+            SDL_FreeSurface(surface);
+            throw std::runtime_error("Failed to create texture: " + std::string(SDL_GetError()));
+        }
+        SDL_BlendMode blendMode = SDL_BLENDMODE_BLEND;
+        SDL_GetTextureBlendMode(m_texture, &blendMode);
+        SDL_SetTextureBlendMode(replacement, blendMode);
+
+        SDL_DestroyTexture(m_texture);
+        m_texture = replacement;
+        m_width = surface->w;
+        m_height = surface->h;
+    }
+
+    SDL_UpdateTexture(m_texture, nullptr, surface->pixels, surface->pitch);
+
+    if (m_surface) {
+        SDL_FreeSurface(m_surface);
+    }
+    m_surface = surface;
+}
+
+Rectangle Texture::visibleScreenRect(const Camera* camera) const {
+    if (camera && camera->hasViewport()) {
+        return camera->getViewport();
+    }
+    SDL_Rect viewport;
+    SDL_RenderGetViewport(m_graphics.getRenderer(), &viewport);
+    return Rectangle{ 0.0f, 0.0f, static_cast<float>(viewport.w), static_cast<float>(viewport.h) };
+}
+
+bool Texture::isOffScreen(const Rectangle& dest, const Rectangle& visible) const {
+    if (dest.intersects(visible)) {
+        m_graphics.frameStats().drawsIssued++;
+        return false;
+    }
+    m_graphics.frameStats().drawsCulled++;
+    return true;
+}
+
+void Texture::copyClipped(const SDL_Rect& source, const Rectangle& dest, const Rectangle& visible) {
+    Rectangle shown = dest.intersection(visible);
+    if (shown.isEmpty() || source.w <= 0 || source.h <= 0) {
+        return;
+    }
+
+    // Trim the source to the texels that land inside the visible area, then
+    // map those whole texels back through the same scale. The trimmed quad
+    // lines up exactly with the untrimmed one, so neighbours don't seam.
+    const float scaleX = dest.width / source.w;
+    const float scaleY = dest.height / source.h;
+    int left = std::max(0, static_cast<int>(std::floor((shown.x - dest.x) / scaleX)));
+    int top = std::max(0, static_cast<int>(std::floor((shown.y - dest.y) / scaleY)));
+    int right = std::min(source.w, static_cast<int>(std::ceil((shown.right() - dest.x) / scaleX)));
+    int bottom = std::min(source.h, static_cast<int>(std::ceil((shown.bottom() - dest.y) / scaleY)));
+    if (right <= left || bottom <= top) {
+        return;
+    }
+
+    SDL_Rect sourceRect = { source.x + left, source.y + top, right - left, bottom - top };
+    SDL_FRect destRect = {
+        dest.x + left * scaleX,
+        dest.y + top * scaleY,
+        (right - left) * scaleX,
+        (bottom - top) * scaleY
+    };
+    SDL_RenderCopyF(m_graphics.getRenderer(), m_texture, &sourceRect, &destRect);
+}
+
+Rectangle Texture::screenBounds(const Rectangle& world, const Camera& camera, Vec2f corners[4]) const {
+    corners[0] = Vec2f{ world.x, world.y };
+    corners[1] = Vec2f{ world.right(), world.y };
+    corners[2] = Vec2f{ world.right(), world.bottom() };
+    corners[3] = Vec2f{ world.x, world.bottom() };
+    camera.worldToScreen(corners, corners, 4);
+    return boundsOf(corners);
+}
+
+Rectangle Texture::boundsOf(const Vec2f corners[4]) {
+    float left = corners[0].x, right = corners[0].x;
+    float top = corners[0].y, bottom = corners[0].y;
+    for (int i = 1; i < 4; ++i) {
+        left = std::min(left, corners[i].x);
+        right = std::max(right, corners[i].x);
+        top = std::min(top, corners[i].y);
+        bottom = std::max(bottom, corners[i].y);
+    }
+    return Rectangle{ left, top, right - left, bottom - top };
+}
+
+void Texture::queueQuad(const SDL_Rect& source, const Vec2f corners[4], BlendMode mode) {
+    queueQuad(SDL_GetRenderTarget(m_graphics.getRenderer()), source, corners,
+              toSDLBlendMode(mode, m_premultiplied), SDL_Color{ 255, 255, 255, 255 });
+}
+
+void Texture::queueQuad(SDL_Texture* target, const SDL_Rect& source, const Vec2f corners[4],
+                        SDL_BlendMode blendMode, SDL_Color color) {
+    const SDL_FRect uv = {
+        static_cast<float>(source.x) / m_width,
+        static_cast<float>(source.y) / m_height,
+        static_cast<float>(source.w) / m_width,
+        static_cast<float>(source.h) / m_height
+    };
+    m_graphics.batch().addQuad(target, m_texture, blendMode, corners, uv, color);
+}
+
 // BitBlt entire texture to screen
 void Texture::render(int worldX, int worldY, const Camera* camera, BlendMode mode) {
-    setBlendMode(mode);
-    
-    int screenX = worldX;
-    int screenY = worldY;
-    int width = m_width;
-    int height = m_height;
+    Rectangle dest = {
+        static_cast<float>(worldX), static_cast<float>(worldY),
+        static_cast<float>(m_width), static_cast<float>(m_height)
+    };
+    const Rectangle visible = visibleScreenRect(camera);
+
+    // Rotated views can't use axis-aligned copies; queue a transformed quad
+    if (camera && camera->isRotated()) {
+        Vec2f corners[4];
+        if (!isOffScreen(screenBounds(dest, *camera, corners), visible)) {
+            queueQuad(SDL_Rect{ 0, 0, m_width, m_height }, corners, mode);
+        }
+        return;
+    }
     
     if (camera) {
-        camera->worldToScreen(worldX, worldY, screenX, screenY);
-        width = static_cast<int>(width * camera->getZoom());
-        height = static_cast<int>(height * camera->getZoom());
+        const float zoom = camera->getZoom();
+        camera->worldToScreen(static_cast<float>(worldX), static_cast<float>(worldY), dest.x, dest.y);
+        dest.width = m_width * zoom;
+        dest.height = m_height * zoom;
     }
     
-    SDL_Rect destRect = { screenX, screenY, width, height };
-    SDL_RenderCopy(m_graphics.getRenderer(), m_texture, nullptr, &destRect);
-    
+    if (isOffScreen(dest, visible)) {
+        return;
+    }
+
+    m_graphics.flushBatch();
+    setBlendMode(mode);
+    copyClipped(SDL_Rect{ 0, 0, m_width, m_height }, dest, visible);
     restoreBlendMode();
 }
 
 // BitBlt entire texture to another texture
 void Texture::render(Texture& target, int destX, int destY, BlendMode mode) {
+    m_graphics.flushBatch();
+
     // Set the blend mode for the source texture
     setBlendMode(mode);
 
@@ -315,70 +690,69 @@ void Texture::render(Texture& target, int destX, int destY, BlendMode mode) {
 // BitBlt region to screen
 void Texture::render(int sourceX, int sourceY, int sourceWidth, int sourceHeight,
                     int destX, int destY, const Camera* camera, BlendMode mode) {
-    setBlendMode(mode);
+    render(SDL_Rect{ sourceX, sourceY, sourceWidth, sourceHeight },
+           static_cast<float>(destX), static_cast<float>(destY), camera, mode);
+}
 
-    int screenX = destX;
-    int screenY = destY;
-    int width = sourceWidth;
-    int height = sourceHeight;
-    
-    if (camera) {
-        camera->worldToScreen(destX, destY, screenX, screenY);
-        width = static_cast<int>(width * camera->getZoom());
-        height = static_cast<int>(height * camera->getZoom());
+void Texture::render(const SDL_Rect& source, float destX, float destY,
+                     const Camera* camera, BlendMode mode) {
+    const int sourceX = source.x;
+    const int sourceY = source.y;
+    const int sourceWidth = source.w;
+    const int sourceHeight = source.h;
+    const Rectangle world = {
+        destX, destY,
+        static_cast<float>(sourceWidth), static_cast<float>(sourceHeight)
+    };
+    const bool rotated = camera && camera->isRotated();
+    float screenX = destX;
+    float screenY = destY;
+    float zoom = 1.0f;
+
+    // Cull the whole region before splitting it into wrapped segments
+    const Rectangle visible = visibleScreenRect(camera);
+    if (rotated) {
+        Vec2f corners[4];
+        if (isOffScreen(screenBounds(world, *camera, corners), visible)) {
+            return;
+        }
+    } else {
+        if (camera) {
+            zoom = camera->getZoom();
+            camera->worldToScreen(world.x, world.y, screenX, screenY);
+        }
+        if (isOffScreen(Rectangle{ screenX, screenY, sourceWidth * zoom, sourceHeight * zoom }, visible)) {
+            return;
+        }
     }
 
-    // Wrap source coordinates to valid texture positions
-    sourceX = sourceX % m_width;
-    sourceY = sourceY % m_height;
-    
-    // Handle negative coordinates by wrapping to positive
-    if (sourceX < 0) sourceX += m_width;
-    if (sourceY < 0) sourceY += m_height;
-    
-    // Calculate how much we need to wrap horizontally
-    int firstWidth = std::min(sourceWidth, m_width - sourceX);
-    int remainingWidth = sourceWidth - firstWidth;
-    
-    // Calculate how much we need to wrap vertically
-    int firstHeight = std::min(sourceHeight, m_height - sourceY);
-    int remainingHeight = sourceHeight - firstHeight;
-    
-    // First segment (top-left)
-    SDL_Rect sourceRect = { sourceX, sourceY, firstWidth, firstHeight };
-    SDL_Rect destRect = { screenX, screenY, 
-                         static_cast<int>(firstWidth * camera->getZoom()), 
-                         static_cast<int>(firstHeight * camera->getZoom()) };
-    SDL_RenderCopy(m_graphics.getRenderer(), m_texture, &sourceRect, &destRect);
-    
-    // If we need to wrap horizontally, render the top-right segment
-    if (remainingWidth > 0) {
-        sourceRect = { 0, sourceY, remainingWidth, firstHeight };
-        destRect = { screenX + static_cast<int>(firstWidth * camera->getZoom()), 
-                    screenY, 
-                    static_cast<int>(remainingWidth * camera->getZoom()),
-                    static_cast<int>(firstHeight * camera->getZoom()) };
-        SDL_RenderCopy(m_graphics.getRenderer(), m_texture, &sourceRect, &destRect);
-    }
-    
-    // If we need to wrap vertically, render the bottom-left segment
-    if (remainingHeight > 0) {
-        sourceRect = { sourceX, 0, firstWidth, remainingHeight };
-        destRect = { screenX, 
-                    screenY + static_cast<int>(firstHeight * camera->getZoom()),
-                    static_cast<int>(firstWidth * camera->getZoom()),
-                    static_cast<int>(remainingHeight * camera->getZoom()) };
-        SDL_RenderCopy(m_graphics.getRenderer(), m_texture, &sourceRect, &destRect);
+    WrapSegment segments[4];
+    const int segmentCount = wrapSegments(sourceX, sourceY, sourceWidth, sourceHeight, segments);
+
+    if (rotated) {
+        for (int i = 0; i < segmentCount; ++i) {
+            const WrapSegment& segment = segments[i];
+            Rectangle piece = {
+                world.x + segment.offsetX, world.y + segment.offsetY,
+                static_cast<float>(segment.source.w), static_cast<float>(segment.source.h)
+            };
+            Vec2f corners[4];
+            screenBounds(piece, *camera, corners);
+            queueQuad(segment.source, corners, mode);
+        }
+        return;
     }
-    
-    // If we need to wrap both horizontally and vertically, render the bottom-right segment
-    if (remainingWidth > 0 && remainingHeight > 0) {
-        sourceRect = { 0, 0, remainingWidth, remainingHeight };
-        destRect = { screenX + static_cast<int>(firstWidth * camera->getZoom()),
-                    screenY + static_cast<int>(firstHeight * camera->getZoom()),
-                    static_cast<int>(remainingWidth * camera->getZoom()),
-                    static_cast<int>(remainingHeight * camera->getZoom()) };
-        SDL_RenderCopy(m_graphics.getRenderer(), m_texture, &sourceRect, &destRect);
+
+    m_graphics.flushBatch();
+    setBlendMode(mode);
+
+    // Segment edges are computed in float so wrapped pieces meet exactly
+    for (int i = 0; i < segmentCount; ++i) {
+        const WrapSegment& segment = segments[i];
+        copyClipped(segment.source,
+                    Rectangle{ screenX + segment.offsetX * zoom, screenY + segment.offsetY * zoom,
+                               segment.source.w * zoom, segment.source.h * zoom },
+                    visible);
     }
 
     restoreBlendMode();
@@ -388,6 +762,7 @@ void Texture::render(Texture& target,
                    int sourceX, int sourceY, int sourceWidth, int sourceHeight,
                    int destX, int destY, BlendMode mode) {
 
+    m_graphics.flushBatch();
     setBlendMode(mode);
 
     // Store current render target
@@ -395,7 +770,26 @@ void Texture::render(Texture& target,
     
     // Set the target texture as render target
     SDL_SetRenderTarget(m_graphics.getRenderer(), target.m_texture);
+
+    WrapSegment segments[4];
+    const int segmentCount = wrapSegments(sourceX, sourceY, sourceWidth, sourceHeight, segments);
+    for (int i = 0; i < segmentCount; ++i) {
+        const WrapSegment& segment = segments[i];
+        SDL_Rect destRect = {
+            destX + segment.offsetX, destY + segment.offsetY,
+            segment.source.w, segment.source.h
+        };
+        SDL_RenderCopy(m_graphics.getRenderer(), m_texture, &segment.source, &destRect);
+    }
     
+    // Restore previous render target
+    SDL_SetRenderTarget(m_graphics.getRenderer(), previousTarget);
+
+    restoreBlendMode();
+}
+
+int Texture::wrapSegments(int sourceX, int sourceY, int sourceWidth, int sourceHeight,
+                          WrapSegment segments[4]) const {
     // Wrap source coordinates to valid texture positions
     sourceX = sourceX % m_width;
     sourceY = sourceY % m_height;
@@ -411,37 +805,261 @@ void Texture::render(Texture& target,
     // Calculate how much we need to wrap vertically
     int firstHeight = std::min(sourceHeight, m_height - sourceY);
     int remainingHeight = sourceHeight - firstHeight;
-    
-    // First segment (top-left)
-    SDL_Rect sourceRect = { sourceX, sourceY, firstWidth, firstHeight };
-    SDL_Rect destRect = { destX, destY, firstWidth, firstHeight };
-    SDL_RenderCopy(m_graphics.getRenderer(), m_texture, &sourceRect, &destRect);
-    
-    // If we need to wrap horizontally, render the top-right segment
+
+    // Top-left, then top-right, bottom-left and bottom-right when it wraps
+    int count = 0;
+    segments[count++] = { { sourceX, sourceY, firstWidth, firstHeight }, 0, 0 };
     if (remainingWidth > 0) {
-        sourceRect = { 0, sourceY, remainingWidth, firstHeight };
-        destRect = { destX + firstWidth, destY, remainingWidth, firstHeight };
-        SDL_RenderCopy(m_graphics.getRenderer(), m_texture, &sourceRect, &destRect);
+        segments[count++] = { { 0, sourceY, remainingWidth, firstHeight }, firstWidth, 0 };
     }
-    
-    // If we need to wrap vertically, render the bottom-left segment
     if (remainingHeight > 0) {
-        sourceRect = { sourceX, 0, firstWidth, remainingHeight };
-        destRect = { destX, destY + firstHeight, firstWidth, remainingHeight };
-        SDL_RenderCopy(m_graphics.getRenderer(), m_texture, &sourceRect, &destRect);
+        segments[count++] = { { sourceX, 0, firstWidth, remainingHeight }, 0, firstHeight };
     }
-    
-    // If we need to wrap both horizontally and vertically, render the bottom-right segment
     if (remainingWidth > 0 && remainingHeight > 0) {
-        sourceRect = { 0, 0, remainingWidth, remainingHeight };
-        destRect = { destX + firstWidth, destY + firstHeight, remainingWidth, remainingHeight };
-        SDL_RenderCopy(m_graphics.getRenderer(), m_texture, &sourceRect, &destRect);
+        segments[count++] = { { 0, 0, remainingWidth, remainingHeight }, firstWidth, firstHeight };
     }
-    
-    // Restore previous render target
-    SDL_SetRenderTarget(m_graphics.getRenderer(), previousTarget);
+    return count;
+}
 
-    restoreBlendMode();
+void Texture::transformCorners(const Rectangle& piece, const Vec2f& pivot,
+                               const DrawParams& params, const Camera* camera, Vec2f corners[4]) {
+    corners[0] = Vec2f{ piece.x, piece.y };
+    corners[1] = Vec2f{ piece.right(), piece.y };
+    corners[2] = Vec2f{ piece.right(), piece.bottom() };
+    corners[3] = Vec2f{ piece.x, piece.bottom() };
+
+    // Mirror and rotate about the pivot. Moving the corners rather than the
+    // texture coordinates flips the texels along with them.
+    const float cosine = std::cos(params.rotation);
+    const float sine = std::sin(params.rotation);
+    for (int i = 0; i < 4; ++i) {
+        float dx = corners[i].x - pivot.x;
+        float dy = corners[i].y - pivot.y;
+        if (params.flipHorizontal) dx = -dx;
+        if (params.flipVertical) dy = -dy;
+        corners[i] = Vec2f{ pivot.x + dx * cosine - dy * sine, pivot.y + dx * sine + dy * cosine };
+    }
+
+    if (camera) {
+        camera->worldToScreen(corners, corners, 4);
+    }
+}
+
+SDL_Color Texture::vertexColor(const DrawParams& params) const {
+    const float opacity = std::min(1.0f, std::max(0.0f, params.opacity));
+    const float alpha = opacity * params.tint.a / 255.0f;
+    auto channel = [](float value) { return static_cast<Uint8>(value + 0.5f); };
+
+    // Premultiplied texels need the whole color scaled, not just alpha
+    const float colorScale = m_premultiplied ? alpha : 1.0f;
+    return SDL_Color{
+        channel(params.tint.r * colorScale),
+        channel(params.tint.g * colorScale),
+        channel(params.tint.b * colorScale),
+        channel(255.0f * alpha)
+    };
+}
+
+void Texture::queueRegion(Texture* target, int sourceX, int sourceY, int sourceWidth, int sourceHeight,
+                          const Rectangle& frame, const Camera* camera, const DrawParams& params) {
+    if (sourceWidth <= 0 || sourceHeight <= 0) {
+        return;
+    }
+
+    const Vec2f center = { frame.x + frame.width * 0.5f, frame.y + frame.height * 0.5f };
+    Vec2f corners[4];
+    if (!target) {
+        // Cull the whole draw before splitting it into wrapped segments
+        transformCorners(frame, center, params, camera, corners);
+        if (isOffScreen(boundsOf(corners), visibleScreenRect(camera))) {
+            return;
+        }
+    }
+
+    SDL_Texture* destination = target ? target->m_texture : SDL_GetRenderTarget(m_graphics.getRenderer());
+    const SDL_BlendMode blendMode = toSDLBlendMode(params.blendMode, m_premultiplied);
+    const SDL_Color color = vertexColor(params);
+
+    WrapSegment segments[4];
+    const int segmentCount = wrapSegments(sourceX, sourceY, sourceWidth, sourceHeight, segments);
+    for (int i = 0; i < segmentCount; ++i) {
+        const WrapSegment& segment = segments[i];
+        Rectangle piece = {
+            frame.x + segment.offsetX, frame.y + segment.offsetY,
+            static_cast<float>(segment.source.w), static_cast<float>(segment.source.h)
+        };
+        transformCorners(piece, center, params, camera, corners);
+        queueQuad(destination, segment.source, corners, blendMode, color);
+    }
+}
+
+// Whole texture to screen with per-draw parameters
+void Texture::render(int x, int y, const Camera* camera, const DrawParams& params) {
+    const Rectangle frame = {
+        static_cast<float>(x), static_cast<float>(y),
+        static_cast<float>(m_width), static_cast<float>(m_height)
+    };
+    queueRegion(nullptr, 0, 0, m_width, m_height, frame, camera, params);
+}
+
+// Region to screen with per-draw parameters
+void Texture::render(int sourceX, int sourceY, int sourceWidth, int sourceHeight,
+                     int destX, int destY, const Camera* camera, const DrawParams& params) {
+    const Rectangle frame = {
+        static_cast<float>(destX), static_cast<float>(destY),
+        static_cast<float>(sourceWidth), static_cast<float>(sourceHeight)
+    };
+    queueRegion(nullptr, sourceX, sourceY, sourceWidth, sourceHeight, frame, camera, params);
+}
+
+// Whole texture to another texture with per-draw parameters
+void Texture::render(Texture& target, int destX, int destY, const DrawParams& params) {
+    const Rectangle frame = {
+        static_cast<float>(destX), static_cast<float>(destY),
+        static_cast<float>(m_width), static_cast<float>(m_height)
+    };
+    queueRegion(&target, 0, 0, m_width, m_height, frame, nullptr, params);
+}
+
+// Region to another texture with per-draw parameters
+void Texture::render(Texture& target,
+                     int sourceX, int sourceY, int sourceWidth, int sourceHeight,
+                     int destX, int destY, const DrawParams& params) {
+    const Rectangle frame = {
+        static_cast<float>(destX), static_cast<float>(destY),
+        static_cast<float>(sourceWidth), static_cast<float>(sourceHeight)
+    };
+    queueRegion(&target, sourceX, sourceY, sourceWidth, sourceHeight, frame, nullptr, params);
+}
+
+SDL_Rect Texture::stamp(Texture& target, const StampPlacement& placement, const DrawParams& params) {
+    return stamp(target, SDL_Rect{ 0, 0, m_width, m_height }, placement, params);
+}
+
+SDL_Rect Texture::stamp(Texture& target, const SDL_Rect& source, const StampPlacement& placement,
+                        const DrawParams& params) {
+    // Stamps don't wrap; keep the region inside the texture
+    const SDL_Rect bounds = { 0, 0, m_width, m_height };
+    SDL_Rect region;
+    if (!SDL_IntersectRect(&source, &bounds, &region)) {
+        return SDL_Rect{ 0, 0, 0, 0 };
+    }
+
+    // The scaled region with the pivot at the placement point. A negative
+    // scale mirrors the corners, which flips the stamp like DrawParams does.
+    const float width = region.w * placement.scaleX;
+    const float height = region.h * placement.scaleY;
+    const Rectangle piece = {
+        placement.x - placement.pivotX * width,
+        placement.y - placement.pivotY * height,
+        width, height
+    };
+
+    Vec2f corners[4];
+    transformCorners(piece, Vec2f{ placement.x, placement.y }, params, nullptr, corners);
+    queueQuad(target.m_texture, region, corners,
+              toSDLBlendMode(params.blendMode, m_premultiplied), vertexColor(params));
+
+    // Whole pixels the quad overlaps, on the target
+    const Rectangle reach = boundsOf(corners);
+    const int left = static_cast<int>(std::floor(reach.x));
+    const int top = static_cast<int>(std::floor(reach.y));
+    const SDL_Rect touched = {
+        left, top,
+        static_cast<int>(std::ceil(reach.x + reach.width)) - left,
+        static_cast<int>(std::ceil(reach.y + reach.height)) - top
+    };
+    const SDL_Rect targetBounds = { 0, 0, target.m_width, target.m_height };
+    SDL_Rect result;
+    if (!SDL_IntersectRect(&touched, &targetBounds, &result)) {
+        return SDL_Rect{ 0, 0, 0, 0 };
+    }
+    return result;
+}
+
+SDL_Rect Texture::floodFill(int x, int y, Color color, int tolerance) {
+    if (x < 0 || x >= m_width || y < 0 || y >= m_height) {
+        return SDL_Rect{ 0, 0, 0, 0 };
+    }
+
+    // Tiles are read back only as the fill reaches them
+    FloodFill::Region region;
+    const bool grown = FloodFill::grow(
+        [this](const SDL_Rect& rect, uint32_t* pixels, int pitch) {
+            return readPixels(rect, pixels, pitch);
+        },
+        m_width, m_height, x, y, tolerance, region);
+    if (!grown) {
+        throw std::runtime_error("Failed to read texture for fill: " + std::string(SDL_GetError()));
+    }
+    if (SDL_RectEmpty(&region.bounds)) {
+        return region.bounds;
+    }
+
+    color = storedColor(color);
+    SDL_PixelFormat* format = SDL_AllocFormat(getFormat());
+    const uint32_t value = SDL_MapRGBA(format, color.r, color.g, color.b, color.a);
+    SDL_FreeFormat(format);
+
+    std::vector<int> tiles;
+    for (int tile = 0; tile < region.tilesX * region.tilesY; ++tile) {
+        if (region.touched[tile]) {
+            tiles.push_back(tile);
+        }
+    }
+
+    // Color the filled pixels in each touched tile's copy across the pool,
+    // then upload just those tiles
+    const int tileSize = FloodFill::TileSize;
+    ThreadPool::instance().parallelFor(static_cast<int>(tiles.size()), 1, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            uint32_t* pixels = region.pixels[tiles[i]].data();
+            const uint8_t* mask = region.masks[tiles[i]].data();
+            for (size_t p = 0; p < static_cast<size_t>(tileSize) * tileSize; ++p) {
+                if (mask[p]) {
+                    pixels[p] = value;
+                }
+            }
+        }
+    });
+    for (int tile : tiles) {
+        const SDL_Rect rect = region.tileRect(tile % region.tilesX, tile / region.tilesX, m_width, m_height);
+        writePixels(rect, region.pixels[tile].data(), tileSize * 4);
+    }
+
+    return region.bounds;
+}
+
+void Texture::applyBlur(const Filter::Blur& blur, const SDL_Rect* area) {
+    const SDL_Rect full = { 0, 0, m_width, m_height };
+    SDL_Rect rect = full;
+    if ((area && !SDL_IntersectRect(area, &full, &rect)) || blur.isEmpty()) {
+        return;
+    }
+
+    // Read the area plus the halo the blur needs around it
+    const int halo = blur.halo();
+    SDL_Rect context = { rect.x - halo, rect.y - halo, rect.w + 2 * halo, rect.h + 2 * halo };
+    SDL_IntersectRect(&context, &full, &context);
+    std::vector<uint32_t> source(static_cast<size_t>(context.w) * context.h);
+    if (!readPixels(context, source.data(), context.w * 4)) {
+        throw std::runtime_error("Failed to read texture for blur: " + std::string(SDL_GetError()));
+    }
+
+    // Blur premultiplied so transparent pixels don't darken the edges
+    const Uint32 format = getFormat();
+    if (!m_premultiplied) {
+        PixelConvert::premultiply(source.data(), context.w * 4, format, context.w, context.h);
+    }
+
+    std::vector<uint32_t> result(static_cast<size_t>(rect.w) * rect.h);
+    const SDL_Rect local = { rect.x - context.x, rect.y - context.y, rect.w, rect.h };
+    Filter::apply(blur, source.data(), context.w * 4, context.w, context.h, local, result.data(), rect.w * 4);
+
+    if (!m_premultiplied) {
+        PixelConvert::unpremultiply(result.data(), rect.w * 4, format, rect.w, rect.h);
+    }
+    writePixels(rect, result.data(), rect.w * 4);
 }
 
 Color Texture::getPixel(int x, int y) const {
@@ -454,29 +1072,157 @@ Color Texture::getPixel(int x, int y) const {
     Uint8 r, g, b, a;
     SDL_GetRGBA(pixel, m_surface->format, &r, &g, &b, &a);
 
+    if (m_premultiplied) {
+        auto straight = [a](Uint8 value) {
+            return a == 0 ? Uint8(0) : static_cast<Uint8>(std::min(255, (value * 255 + a / 2) / a));
+        };
+        r = straight(r);
+        g = straight(g);
+        b = straight(b);
+    }
+
     return Color{r, g, b, a};
 }
 
+Uint32 Texture::getFormat() const {
+    return m_graphics.getNativeFormat();
+}
+
+bool Texture::readPixels(const SDL_Rect& rect, void* pixels, int pitch) const {
+    const size_t rowBytes = static_cast<size_t>(rect.w) * 4;
+    if (m_stream) {
+        for (int y = 0; y < rect.h; ++y) {
+            std::memcpy(static_cast<uint8_t*>(pixels) + static_cast<size_t>(y) * pitch,
+                        m_stream->staging.data() + static_cast<size_t>(rect.y + y) * m_width + rect.x,
+                        rowBytes);
+        }
+        return true;
+    }
+
+    m_graphics.flushBatch();
+    SDL_Renderer* renderer = m_graphics.getRenderer();
+    SDL_Texture* previousTarget = SDL_GetRenderTarget(renderer);
+    const Uint32 format = m_graphics.getNativeFormat();
+
+    // Render targets can be read directly; anything else is copied into a
+    // temporary target first
+    int access = SDL_TEXTUREACCESS_STATIC;
+    SDL_QueryTexture(m_texture, nullptr, &access, nullptr, nullptr);
+    int result;
+    if (access == SDL_TEXTUREACCESS_TARGET) {
+        SDL_SetRenderTarget(renderer, m_texture);
+        result = SDL_RenderReadPixels(renderer, &rect, format, pixels, pitch);
+    } else {
+        // Taken and handed straight back, so reading many tiles in one frame
+        // keeps reusing a single target
+        FrameArena& arena = m_graphics.frameArena();
+        SDL_Texture* readTexture = arena.takeTarget(rect.w, rect.h);
+        if (!readTexture) {
+            return false;
+        }
+        SDL_SetRenderTarget(renderer, readTexture);
+
+        SDL_BlendMode previousBlendMode;
+        SDL_GetTextureBlendMode(m_texture, &previousBlendMode);
+        SDL_SetTextureBlendMode(m_texture, SDL_BLENDMODE_NONE);
+        SDL_RenderCopy(renderer, m_texture, &rect, nullptr);
+        SDL_SetTextureBlendMode(m_texture, previousBlendMode);
+
+        result = SDL_RenderReadPixels(renderer, nullptr, format, pixels, pitch);
+        arena.adoptTarget(readTexture);
+    }
+
+    SDL_SetRenderTarget(renderer, previousTarget);
+    return result == 0;
+}
+
+void Texture::writePixels(const SDL_Rect& rect, const void* pixels, int pitch) {
+    const size_t rowBytes = static_cast<size_t>(rect.w) * 4;
+    if (m_stream) {
+        PixelSpan span = lock(&rect);
+        for (int y = 0; y < span.height; ++y) {
+            std::memcpy(span.row(y), static_cast<const uint8_t*>(pixels) + static_cast<size_t>(y) * pitch, rowBytes);
+        }
+        unlock();
+        return;
+    }
+
+    m_graphics.flushBatch();
+    SDL_UpdateTexture(m_texture, &rect, pixels, pitch);
+
+    // Keep the CPU copy getPixel() reads in step, if it matches the texture
+    if (m_surface && m_surface->w == m_width && m_surface->h == m_height) {
+        for (int y = 0; y < rect.h; ++y) {
+            std::memcpy(static_cast<uint8_t*>(m_surface->pixels) + static_cast<size_t>(rect.y + y) * m_surface->pitch + rect.x * 4,
+                        static_cast<const uint8_t*>(pixels) + static_cast<size_t>(y) * pitch,
+                        rowBytes);
+        }
+    }
+}
+
+Color Texture::storedColor(Color color) const {
+    // The color is given with straight alpha
+    if (m_premultiplied) {
+        color.r = static_cast<uint8_t>((color.r * color.a + 127) / 255);
+        color.g = static_cast<uint8_t>((color.g * color.a + 127) / 255);
+        color.b = static_cast<uint8_t>((color.b * color.a + 127) / 255);
+    }
+    return color;
+}
+
 void Texture::clear(uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
-    // Store current render target
-    SDL_Texture* previousTarget = SDL_GetRenderTarget(m_graphics.getRenderer());
-    
-    // Set this texture as render target
-    SDL_SetRenderTarget(m_graphics.getRenderer(), m_texture);
-    
-    // Clear with specified color
-    SDL_SetRenderDrawColor(m_graphics.getRenderer(), r, g, b, a);
-    SDL_RenderClear(m_graphics.getRenderer());
-    
-    // Restore previous target
-    SDL_SetRenderTarget(m_graphics.getRenderer(), previousTarget);
+    clear(SDL_Rect{ 0, 0, m_width, m_height }, r, g, b, a);
 }
 
-bool Texture::save(const std::string& path) const {
-    // Create a surface to hold our texture data
-    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(
-        0, m_width, m_height, 32, SDL_PIXELFORMAT_RGBA32
-    );
+void Texture::clear(const SDL_Rect& area, uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    const SDL_Rect bounds = { 0, 0, m_width, m_height };
+    SDL_Rect clipped;
+    if (!SDL_IntersectRect(&area, &bounds, &clipped)) {
+        return;
+    }
+    const Color color = storedColor(Color{ r, g, b, a });
+
+    if (m_stream) {
+        // Streaming textures can't be render targets; fill the staging copy
+        SDL_PixelFormat* format = SDL_AllocFormat(m_graphics.getNativeFormat());
+        uint32_t value = SDL_MapRGBA(format, color.r, color.g, color.b, color.a);
+        SDL_FreeFormat(format);
+
+        PixelSpan span = lock(&clipped);
+        for (int y = 0; y < span.height; ++y) {
+            std::fill(span.row(y), span.row(y) + span.width, value);
+        }
+        unlock();
+        return;
+    }
+
+    m_graphics.flushBatch();
+
+    SDL_Renderer* renderer = m_graphics.getRenderer();
+    SDL_Texture* previousTarget = SDL_GetRenderTarget(renderer);
+    SDL_BlendMode previousMode;
+    SDL_GetRenderDrawBlendMode(renderer, &previousMode);
+
+    // A fill rather than SDL_RenderClear, which ignores the area; no
+    // blending so the color replaces what was there
+    SDL_SetRenderTarget(renderer, m_texture);
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+    SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
+    SDL_RenderFillRect(renderer, &clipped);
+
+    SDL_SetRenderDrawBlendMode(renderer, previousMode);
+    SDL_SetRenderTarget(renderer, previousTarget);
+}
+
+bool Texture::save(const std::string& path, Format fileFormat) const {
+    m_graphics.flushBatch();
+
+    // Read back in the native format; both encoders convert to RGBA themselves
+    const Uint32 format = m_graphics.getNativeFormat();
+
+    // Scratch surface and read target come from the frame arena
+    FrameArena& arena = m_graphics.frameArena();
+    SDL_Surface* surface = arena.surface(m_width, m_height);
     
     if (!surface) {
         return false;
@@ -486,15 +1232,9 @@ bool Texture::save(const std::string& path) const {
     SDL_Texture* previousTarget = SDL_GetRenderTarget(m_graphics.getRenderer());
     
     // Set up a temporary texture for reading
-    SDL_Texture* readTexture = SDL_CreateTexture(
-        m_graphics.getRenderer(),
-        SDL_PIXELFORMAT_RGBA32,
-        SDL_TEXTUREACCESS_TARGET,
-        m_width, m_height
-    );
+    SDL_Texture* readTexture = arena.renderTarget(m_width, m_height);
     
     if (!readTexture) {
-        SDL_FreeSurface(surface);
         return false;
     }
     
@@ -518,60 +1258,102 @@ bool Texture::save(const std::string& path) const {
     SDL_RenderReadPixels(
         m_graphics.getRenderer(),
         nullptr,
-        SDL_PIXELFORMAT_RGBA32,
+        format,
         surface->pixels,
         surface->pitch
     );
     
     // Restore previous render target
     SDL_SetRenderTarget(m_graphics.getRenderer(), previousTarget);
-    SDL_DestroyTexture(readTexture);
+
+    // Files always hold straight alpha
+    if (m_premultiplied) {
+        PixelConvert::unpremultiply(surface->pixels, surface->pitch, format, m_width, m_height);
+    }
     
-    // Save the surface as a PNG file
-    bool success = (IMG_SavePNG(surface, path.c_str()) == 0);
-    SDL_FreeSurface(surface);
+    if (format != SDL_PIXELFORMAT_RGBA32) {
+        m_graphics.frameStats().formatConversions++;
+    }
+
+    bool success = false;
+    if (fileFormat == Format::Fast) {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (file) {
+            Qoi::Encoder encoder(file, m_width, m_height);
+            encoder.writeRows(surface->pixels, surface->pitch, format, m_height);
+            success = encoder.finish();
+        }
+    } else {
+        // Save the surface as a PNG file
+        success = (IMG_SavePNG(surface, path.c_str()) == 0);
+    }
     
     return success;
 }
 
 void Texture::applyMask(Texture& mask) {
+    if (m_stream) {
+        throw std::runtime_error("Streaming textures cannot be masked in place");
+    }
     if (m_width != mask.m_width || m_height != mask.m_height) {
         throw std::runtime_error("Texture and mask must be the same size");
     }
+    m_graphics.flushBatch();
 
-    // Create a new texture to hold the composite result
+    // Take a target from the frame arena to hold the composite result
+    FrameArena& arena = m_graphics.frameArena();
     Texture composite(m_graphics);
-    composite.m_texture = SDL_CreateTexture(
-        m_graphics.getRenderer(),
-        SDL_PIXELFORMAT_RGBA8888,
-        SDL_TEXTUREACCESS_TARGET,
-        m_width, m_height
-    );
+    composite.m_texture = arena.takeTarget(m_width, m_height);
     if (!composite.m_texture) {
         throw std::runtime_error("Failed to create composite texture: " + std::string(SDL_GetError()));
     }
-    SDL_SetTextureBlendMode(composite.m_texture, SDL_BLENDMODE_BLEND);
 
     // Store the current render target
     SDL_Texture* previousTarget = SDL_GetRenderTarget(m_graphics.getRenderer());
     SDL_SetRenderTarget(m_graphics.getRenderer(), composite.m_texture);
 
-    // Step 1: Stamp the mask onto the composite texture (overwrite alpha)
-    SDL_SetTextureBlendMode(mask.m_texture, SDL_BLENDMODE_NONE);
     SDL_Rect fullRect = { 0, 0, m_width, m_height };
-    SDL_RenderCopy(m_graphics.getRenderer(), mask.m_texture, nullptr, &fullRect);
+    if (m_premultiplied) {
+        // Step 1: Copy this texture as is
+        SDL_SetTextureBlendMode(m_texture, SDL_BLENDMODE_NONE);
+        SDL_RenderCopy(m_graphics.getRenderer(), m_texture, nullptr, &fullRect);
+
+        // Step 2: Scale every channel by the mask's alpha, which keeps the
+        // result premultiplied whatever the mask's color or convention
+        SDL_BlendMode previousMaskBlendMode;
+        SDL_GetTextureBlendMode(mask.m_texture, &previousMaskBlendMode);
+        SDL_SetTextureBlendMode(mask.m_texture, SDL_ComposeCustomBlendMode(
+            SDL_BLENDFACTOR_ZERO,
+            SDL_BLENDFACTOR_SRC_ALPHA,
+            SDL_BLENDOPERATION_ADD,
+            SDL_BLENDFACTOR_ZERO,
+            SDL_BLENDFACTOR_SRC_ALPHA,
+            SDL_BLENDOPERATION_ADD
+        ));
+        SDL_RenderCopy(m_graphics.getRenderer(), mask.m_texture, nullptr, &fullRect);
+        SDL_SetTextureBlendMode(mask.m_texture, previousMaskBlendMode);
+    } else {
+        // Step 1: Stamp the mask onto the composite texture (overwrite alpha)
+        SDL_SetTextureBlendMode(mask.m_texture, SDL_BLENDMODE_NONE);
+        SDL_RenderCopy(m_graphics.getRenderer(), mask.m_texture, nullptr, &fullRect);
 
-    // Step 2: Stamp the grass onto the composite texture (modulate with alpha)
-    SDL_SetTextureBlendMode(m_texture, SDL_BLENDMODE_MOD);
-    SDL_RenderCopy(m_graphics.getRenderer(), m_texture, nullptr, &fullRect);
+        // Step 2: Stamp the grass onto the composite texture (modulate with alpha)
+        SDL_SetTextureBlendMode(m_texture, SDL_BLENDMODE_MOD);
+        SDL_RenderCopy(m_graphics.getRenderer(), m_texture, nullptr, &fullRect);
+    }
 
-    // Restore the original render target
-    SDL_SetRenderTarget(m_graphics.getRenderer(), previousTarget);
+    // Restore the original render target. Inside a pass drawing into this
+    // texture that is the old texture, which is about to go back to the
+    // arena; bind its replacement instead.
+    SDL_SetRenderTarget(m_graphics.getRenderer(),
+                        previousTarget == m_texture ? composite.m_texture : previousTarget);
     SDL_SetRenderDrawBlendMode(m_graphics.getRenderer(), SDL_BLENDMODE_BLEND);
 
-    // Step 3: Replace this texture with the composite
-    SDL_DestroyTexture(m_texture);
+    // Step 3: Replace this texture with the composite. The old texture goes
+    // back to the arena, so masking every frame keeps swapping the same two.
+    arena.adoptTarget(m_texture);
     m_texture = composite.m_texture;
+    SDL_SetTextureBlendMode(m_texture, toSDLBlendMode(BlendMode::Alpha, m_premultiplied));
 
     // The composite texture is now owned by this Texture object
     composite.m_texture = nullptr;
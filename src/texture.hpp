@@ -2,16 +2,22 @@
 #pragma once
 #include <SDL2/SDL.h>
 #include <string>
+#include <memory>
+#include <vector>
 #include "camera.hpp"
+#include "geometry_batch.hpp"
 
 class Graphics;
+class DecodedCache;
+namespace Filter { class Blur; }
 
 enum class BlendMode {
     None,           // No blending
     Alpha,          // Regular alpha blending
     Additive,       // Colors are added together
     Multiply,       // Colors are multiplied together
-    AlphaPreserve   // Add this new mode
+    AlphaPreserve,  // Add this new mode
+    MaxAlpha        // Color blends as Alpha; alpha keeps the larger of source and destination
 };
 
 // In texture.hpp:
@@ -19,6 +25,41 @@ struct Color {
     uint8_t r, g, b, a;
 };
 
+// Per-draw state for the DrawParams render overloads. Tint and opacity
+// travel as vertex colors, so draws of one texture that differ only in
+// these still share a batch submission.
+struct DrawParams {
+    Color tint = { 255, 255, 255, 255 };    // Straight alpha
+    float opacity = 1.0f;
+    BlendMode blendMode = BlendMode::Alpha;
+    bool flipHorizontal = false;
+    bool flipVertical = false;
+    float rotation = 0.0f;      // Radians, clockwise about the destination's center or stamp pivot
+};
+
+// Where a stamp lands. The pivot, a point of the source region given as
+// 0..1 in each axis, is placed at x, y; the region is scaled about it, then
+// flipped and rotated about it as DrawParams says.
+struct StampPlacement {
+    float x = 0.0f;
+    float y = 0.0f;
+    float scaleX = 1.0f;
+    float scaleY = 1.0f;
+    float pivotX = 0.5f;
+    float pivotY = 0.5f;
+};
+
+// Writable view of a locked region of a streaming Texture. Pixels are in
+// the renderer's native format.
+struct PixelSpan {
+    uint32_t* pixels;   // First pixel of the locked region
+    int pitch;          // Row stride in pixels
+    int width;
+    int height;
+
+    uint32_t* row(int y) const { return pixels + static_cast<size_t>(y) * pitch; }
+};
+
 class Texture {
 public:
     ~Texture();
@@ -29,6 +70,11 @@ public:
         Best      // Best quality but slower
     };
 
+    enum class Format {
+        Png,        // Compact, slow to encode
+        Fast        // QOI; lossless and several times faster, for snapshots
+    };
+
     // Prevent copying
     Texture(const Texture&) = delete;
     Texture& operator=(const Texture&) = delete;
@@ -41,11 +87,35 @@ public:
     static Texture create(Graphics& graphics, int width, int height);
     static Texture create(Graphics& graphics, const std::string& path, bool makeTarget = false);
 
+    // Loads through an on-disk cache of decoded pixels. A hit uploads from
+    // the mapped cache file; a miss decodes normally and queues a write-back.
+    static Texture create(Graphics& graphics, const std::string& path, DecodedCache& cache, bool makeTarget = false);
+
+    // Decodes an image file into a new surface in format; the caller owns
+    // it. Reads anything SDL_image does plus Fast snapshots. Sets converted
+    // if the pixels needed a format conversion. Throws on failure. Safe to
+    // call from any thread.
+    static SDL_Surface* decodeFile(const std::string& path, Uint32 format, bool* converted = nullptr,
+                                   bool premultiply = false);
+
+    // CPU-written texture. Writes go to a staging copy and are uploaded to a
+    // second SDL texture on unlock(), so the CPU can fill frame N+1 while the
+    // GPU still reads frame N. Written pixels must use the texture's alpha
+    // convention (see isPremultiplied()).
+    static Texture createStreaming(Graphics& graphics, int width, int height);
+
+    // Streaming access. The span stays valid until unlock(); its contents
+    // are whatever was last written there.
+    PixelSpan lock(const SDL_Rect* rect = nullptr);
+    void unlock();
+    bool isStreaming() const { return m_stream != nullptr; }
+
     // Saving
-    bool save(const std::string& path) const;
+    bool save(const std::string& path, Format format = Format::Png) const;
 
     // Clearing
     void clear(uint8_t r = 0, uint8_t g = 0, uint8_t b = 0, uint8_t a = 0);
+    void clear(const SDL_Rect& area, uint8_t r = 0, uint8_t g = 0, uint8_t b = 0, uint8_t a = 0);
 
     // Drawing
     void draw(int x, int y);
@@ -54,14 +124,43 @@ public:
     // Manipulation
     void resize(int width, int height, ScaleMode mode = ScaleMode::Linear);
     void applyMask(Texture& mask);
+
+    // Bucket fill: sets the 4-connected area around (x, y) whose pixels are
+    // within tolerance (0..255 per channel) of the one at (x, y) to color.
+    // Reads the texture back once, fills on the CPU and uploads only the
+    // tiles that changed. Returns the filled bounds, empty if nothing was.
+    SDL_Rect floodFill(int x, int y, Color color, int tolerance = 0);
+
+    // Blurs the whole texture, or just area. Pixels around area are read as
+    // context but only area is changed and uploaded.
+    void applyBlur(const Filter::Blur& blur, const SDL_Rect* area = nullptr);
+
+    // Swaps in new pixels, keeping this object (and anything pointing at it)
+    // valid. The surface must be in the renderer's native format with
+    // straight alpha; the texture takes ownership of it and premultiplies it
+    // if needed. The size may change.
+    void replacePixels(SDL_Surface* surface);
     
     // Pixel operations
     Color getPixel(int x, int y) const;
 
+    // Copies a region to or from CPU memory in the renderer's native format,
+    // as stored (premultiplied if the texture is). rect must lie inside the
+    // texture. readPixels returns false if the readback failed.
+    bool readPixels(const SDL_Rect& rect, void* pixels, int pitch) const;
+    void writePixels(const SDL_Rect& rect, const void* pixels, int pitch);
+
     // Properties
     int getWidth() const { return m_width; }
     int getHeight() const { return m_height; }
 
+    // Pixel format of readPixels()/writePixels(), the renderer's native one
+    Uint32 getFormat() const;
+
+    // True if color is stored multiplied by alpha; fixed at creation by
+    // Graphics::usesPremultipliedAlpha()
+    bool isPremultiplied() const { return m_premultiplied; }
+
     void render(int x, int y, const Camera* camera = nullptr, BlendMode mode = BlendMode::Alpha);
     
     void render(Texture& target, int destX, int destY, 
@@ -69,15 +168,101 @@ public:
     
     void render(int sourceX, int sourceY, int sourceWidth, int sourceHeight,
                 int destX, int destY, const Camera* camera = nullptr, BlendMode mode = BlendMode::Alpha);
+
+    // The same at a sub-pixel world position
+    void render(const SDL_Rect& source, float destX, float destY,
+                const Camera* camera = nullptr, BlendMode mode = BlendMode::Alpha);
     
     void render(Texture& target,
                 int sourceX, int sourceY, int sourceWidth, int sourceHeight,
                 int destX, int destY, BlendMode mode = BlendMode::Alpha);
 
+    // Tinted, faded, flipped or rotated draws. These always go through the
+    // geometry batch, on the screen or on target.
+    void render(int x, int y, const Camera* camera, const DrawParams& params);
+
+    void render(int sourceX, int sourceY, int sourceWidth, int sourceHeight,
+                int destX, int destY, const Camera* camera, const DrawParams& params);
+
+    void render(Texture& target, int destX, int destY, const DrawParams& params);
+
+    void render(Texture& target,
+                int sourceX, int sourceY, int sourceWidth, int sourceHeight,
+                int destX, int destY, const DrawParams& params);
+
+    // Brush stamps: the whole texture or a source region as one transformed
+    // quad on target, at sub-pixel positions. Rotated and scaled stamps cost
+    // the same as plain ones and batch together. Return the target pixels
+    // the stamp can touch, empty if it misses.
+    SDL_Rect stamp(Texture& target, const StampPlacement& placement, const DrawParams& params = DrawParams());
+    SDL_Rect stamp(Texture& target, const SDL_Rect& source, const StampPlacement& placement,
+                   const DrawParams& params = DrawParams());
+
 
 private:
+    friend class CommandQueue;  // Binds targets directly when executing recorded commands
+    friend class RenderGraph;   // Binds a pass group's target once
+
     // Private constructor - use create() instead
     Texture(Graphics& graphics);
+
+    // Throws if the size exceeds what the renderer can allocate
+    static void checkSize(Graphics& graphics, int width, int height);
+
+    // Creates the SDL texture for a loaded image and uploads pixels, which
+    // are in the native format. Takes ownership of surface as the CPU copy.
+    static Texture upload(Graphics& graphics, SDL_Surface* surface, bool makeTarget,
+                          const void* pixels, int pitch);
+
+    // Screen area a draw can reach: the camera's viewport, or the
+    // renderer's when there is no camera or viewport
+    Rectangle visibleScreenRect(const Camera* camera) const;
+
+    // True if a screen-space draw misses the visible area. Counts the draw
+    // as culled or issued.
+    bool isOffScreen(const Rectangle& dest, const Rectangle& visible) const;
+
+    // Draws source into dest, trimming both to the visible area first
+    void copyClipped(const SDL_Rect& source, const Rectangle& dest, const Rectangle& visible);
+
+    // Screen corners of a world rect and their bounding box
+    Rectangle screenBounds(const Rectangle& world, const Camera& camera, Vec2f corners[4]) const;
+
+    static Rectangle boundsOf(const Vec2f corners[4]);
+
+    // Queues a source region as a transformed quad on the current target
+    void queueQuad(const SDL_Rect& source, const Vec2f corners[4], BlendMode mode);
+    void queueQuad(SDL_Texture* target, const SDL_Rect& source, const Vec2f corners[4],
+                   SDL_BlendMode blendMode, SDL_Color color);
+
+    // A source region that runs past the texture edge wraps around, giving
+    // up to four pieces. Offsets are in source pixels from the region's
+    // top-left.
+    struct WrapSegment {
+        SDL_Rect source;
+        int offsetX;
+        int offsetY;
+    };
+    int wrapSegments(int sourceX, int sourceY, int sourceWidth, int sourceHeight,
+                     WrapSegment segments[4]) const;
+
+    // Corners of piece after params' flip and rotation about pivot (the
+    // center of the whole draw, or a stamp's pivot), then the camera if
+    // there is one
+    static void transformCorners(const Rectangle& piece, const Vec2f& pivot,
+                                 const DrawParams& params, const Camera* camera, Vec2f corners[4]);
+
+    // Tint and opacity as a vertex color in this texture's alpha convention
+    SDL_Color vertexColor(const DrawParams& params) const;
+
+    // A straight-alpha color as stored, premultiplied if the texture is
+    Color storedColor(Color color) const;
+
+    // Shared by the DrawParams overloads. A null target means the current
+    // one (normally the screen), where the draw is culled like other screen
+    // draws.
+    void queueRegion(Texture* target, int sourceX, int sourceY, int sourceWidth, int sourceHeight,
+                     const Rectangle& frame, const Camera* camera, const DrawParams& params);
     
     Graphics& m_graphics;
     SDL_Texture* m_texture;
@@ -85,18 +270,32 @@ private:
     SDL_BlendMode m_previousBlendMode;
     int m_width = 0;
     int m_height = 0;
+    bool m_premultiplied = false;
+
+    struct StreamingState {
+        SDL_Texture* back = nullptr;        // Receives uploads while m_texture is drawn
+        std::vector<uint32_t> staging;      // Canonical pixels, width * height
+        SDL_Rect frontPending = {0, 0, 0, 0};  // Written since m_texture was last uploaded
+        SDL_Rect backPending = {0, 0, 0, 0};   // Written since back was last uploaded
+        SDL_Rect locked = {0, 0, 0, 0};
+        bool isLocked = false;
+    };
+    std::unique_ptr<StreamingState> m_stream;
 
     void setBlendMode(BlendMode mode) {
         // Store current blend mode before changing it
         SDL_GetTextureBlendMode(m_texture, &m_previousBlendMode);
-        SDL_SetTextureBlendMode(m_texture, toSDLBlendMode(mode));
+        SDL_SetTextureBlendMode(m_texture, toSDLBlendMode(mode, m_premultiplied));
     }
 
     void restoreBlendMode() {
         SDL_SetTextureBlendMode(m_texture, m_previousBlendMode);
     }
 
-    static SDL_BlendMode toSDLBlendMode(BlendMode mode) {
+    static SDL_BlendMode toSDLBlendMode(BlendMode mode, bool premultiplied) {
+        if (premultiplied) {
+            return toPremultipliedBlendMode(mode);
+        }
         switch (mode) {
             case BlendMode::None:
                 return SDL_BLENDMODE_NONE;
@@ -115,9 +314,62 @@ private:
                     SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA,    // destination alpha factor
                     SDL_BLENDOPERATION_ADD                  // alpha operation
                 );
+            case BlendMode::MaxAlpha:
+                return maxAlphaBlendMode(SDL_BLENDFACTOR_SRC_ALPHA);
             default:
                 return SDL_BLENDMODE_BLEND;
         }
     }
 
+    // Source color already carries its alpha, so over-compositing is one
+    // ONE / ONE_MINUS_SRC_ALPHA operation for color and alpha alike, and
+    // AlphaPreserve needs nothing extra
+    static SDL_BlendMode toPremultipliedBlendMode(BlendMode mode) {
+        switch (mode) {
+            case BlendMode::None:
+                return SDL_BLENDMODE_NONE;
+            case BlendMode::Additive:
+                return SDL_ComposeCustomBlendMode(
+                    SDL_BLENDFACTOR_ONE,
+                    SDL_BLENDFACTOR_ONE,
+                    SDL_BLENDOPERATION_ADD,
+                    SDL_BLENDFACTOR_ZERO,
+                    SDL_BLENDFACTOR_ONE,
+                    SDL_BLENDOPERATION_ADD
+                );
+            case BlendMode::Multiply:
+                // src * dst + dst * (1 - srcAlpha), alpha unchanged
+                return SDL_BLENDMODE_MUL;
+            case BlendMode::MaxAlpha:
+                return maxAlphaBlendMode(SDL_BLENDFACTOR_ONE);
+            case BlendMode::Alpha:
+            case BlendMode::AlphaPreserve:
+            default:
+                return SDL_ComposeCustomBlendMode(
+                    SDL_BLENDFACTOR_ONE,
+                    SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA,
+                    SDL_BLENDOPERATION_ADD,
+                    SDL_BLENDFACTOR_ONE,
+                    SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA,
+                    SDL_BLENDOPERATION_ADD
+                );
+        }
+    }
+
+    // Color composites over the destination like Alpha, with sourceColor
+    // as the convention's source factor. Alpha takes the maximum, so
+    // overlapping stamps keep the strongest coverage instead of building
+    // up. Some backends ignore the factors for MAXIMUM; ONE keeps the rest
+    // agreeing.
+    static SDL_BlendMode maxAlphaBlendMode(SDL_BlendFactor sourceColor) {
+        return SDL_ComposeCustomBlendMode(
+            sourceColor,
+            SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA,
+            SDL_BLENDOPERATION_ADD,
+            SDL_BLENDFACTOR_ONE,
+            SDL_BLENDFACTOR_ONE,
+            SDL_BLENDOPERATION_MAXIMUM
+        );
+    }
+
 };
\ No newline at end of file
@@ -0,0 +1,273 @@
+// texture_manager.cpp
+#include "texture_manager.hpp"
+#include "graphics.hpp"
+#include "decoded_cache.hpp"
+#include "file_watcher.hpp"
+#include "thread_pool.hpp"
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+
+TextureManager::TextureManager(Graphics& graphics, size_t budgetBytes)
+    : m_graphics(graphics)
+    , m_budget(budgetBytes)
+    , m_reloads(std::make_shared<ReloadQueue>())
+{
+}
+
+TextureManager::~TextureManager() = default;
+
+TextureManager::ReloadQueue::~ReloadQueue() {
+    for (Result& result : ready) {
+        if (result.surface) {
+            SDL_FreeSurface(result.surface);
+        }
+    }
+}
+
+std::string TextureManager::makeKey(const std::string& canonicalPath, const LoadOptions& options) {
+    std::string key = canonicalPath;
+    key += options.makeTarget ? "|target" : "|static";
+    if (options.width > 0 && options.height > 0) {
+        key += "|" + std::to_string(options.width) + "x" + std::to_string(options.height)
+             + "|" + std::to_string(static_cast<int>(options.scaleMode));
+    }
+    return key;
+}
+
+std::shared_ptr<Texture> TextureManager::loadTexture(const std::string& path) {
+    return loadTexture(path, LoadOptions());
+}
+
+std::shared_ptr<Texture> TextureManager::loadTexture(const std::string& path, const LoadOptions& options) {
+    // Fall back to the path as given if it can't be resolved; loading will
+    // report the real error
+    std::error_code error;
+    std::filesystem::path canonical = std::filesystem::weakly_canonical(path, error);
+    const std::string resolved = error ? path : canonical.string();
+
+    const std::string key = makeKey(resolved, options);
+    auto found = m_entries.find(key);
+    if (found != m_entries.end() && found->second->texture) {
+        Entry& entry = *found->second;
+        m_lru.splice(m_lru.begin(), m_lru, entry.lru);
+        m_stats.hits++;
+        return entry.texture;
+    }
+
+    m_stats.misses++;
+    Entry* entry;
+    if (found != m_entries.end()) {
+        entry = found->second.get();
+        m_stats.reloads++;
+    } else {
+        auto created = std::make_unique<Entry>();
+        created->path = resolved;
+        created->options = options;
+        entry = created.get();
+        m_entries.emplace(key, std::move(created));
+    }
+
+    try {
+        load(*entry);
+    } catch (...) {
+        // Don't keep entries for files that failed to load
+        m_entries.erase(key);
+        throw;
+    }
+
+    // Hold our own reference while trimming so the new texture is never the
+    // one evicted
+    std::shared_ptr<Texture> texture = entry->texture;
+    enforceBudget();
+    return texture;
+}
+
+void TextureManager::load(Entry& entry) {
+    Texture texture = m_decodedCache
+        ? Texture::create(m_graphics, entry.path, *m_decodedCache, entry.options.makeTarget)
+        : Texture::create(m_graphics, entry.path, entry.options.makeTarget);
+    if (entry.options.width > 0 && entry.options.height > 0) {
+        texture.resize(entry.options.width, entry.options.height, entry.options.scaleMode);
+    }
+
+    entry.bytes = static_cast<size_t>(texture.getWidth()) * texture.getHeight() * 4;
+    entry.texture = std::make_shared<Texture>(std::move(texture));
+    m_lru.push_front(&entry);
+    entry.lru = m_lru.begin();
+
+    m_stats.residentBytes += entry.bytes;
+    m_stats.residentEntries++;
+    m_stats.entries = m_entries.size();
+}
+
+void TextureManager::evict(Entry& entry) {
+    m_lru.erase(entry.lru);
+    entry.texture.reset();
+    m_stats.residentBytes -= entry.bytes;
+    m_stats.residentEntries--;
+    m_stats.evictions++;
+}
+
+void TextureManager::enforceBudget() {
+    if (m_budget == 0) {
+        return;
+    }
+
+    // Walk from the least recently used end; textures someone still holds
+    // can't be released and are skipped
+    auto it = m_lru.end();
+    while (m_stats.residentBytes > m_budget && it != m_lru.begin()) {
+        --it;
+        Entry& entry = **it;
+        if (entry.texture.use_count() > 1) {
+            continue;
+        }
+        // evict() erases the node; step past it first
+        auto next = std::next(it);
+        evict(entry);
+        it = next;
+    }
+}
+
+void TextureManager::releaseUnused() {
+    for (auto it = m_entries.begin(); it != m_entries.end();) {
+        Entry& entry = *it->second;
+        if (entry.texture && entry.texture.use_count() > 1) {
+            ++it;
+            continue;
+        }
+        if (entry.texture) {
+            evict(entry);
+        }
+        it = m_entries.erase(it);
+    }
+    m_stats.entries = m_entries.size();
+}
+
+void TextureManager::setBudget(size_t budgetBytes) {
+    m_budget = budgetBytes;
+    enforceBudget();
+}
+
+void TextureManager::enableDecodedCache(const std::string& directory) {
+    m_decodedCache = std::make_unique<DecodedCache>(directory);
+}
+
+bool TextureManager::watchDirectory(const std::string& directory) {
+    if (!FileWatcher::isSupported()) {
+        return false;
+    }
+    if (!m_watcher) {
+        m_watcher = std::make_unique<FileWatcher>();
+    }
+    return m_watcher->addDirectory(directory);
+}
+
+void TextureManager::update() {
+    if (!m_watcher) {
+        return;
+    }
+
+    m_changed.clear();
+    m_watcher->poll(m_changed);
+    for (const std::string& path : m_changed) {
+        if (m_decoding.count(path)) {
+            // The decode in flight may have read the old contents
+            m_changedAgain.insert(path);
+        } else {
+            startDecode(path);
+        }
+    }
+
+    m_finished.clear();
+    {
+        std::lock_guard<std::mutex> lock(m_reloads->mutex);
+        m_finished.swap(m_reloads->ready);
+    }
+    for (ReloadQueue::Result& result : m_finished) {
+        m_decoding.erase(result.path);
+        if (m_changedAgain.erase(result.path)) {
+            if (result.surface) {
+                SDL_FreeSurface(result.surface);
+            }
+            startDecode(result.path);
+            continue;
+        }
+        applyReload(result);
+    }
+}
+
+void TextureManager::startDecode(const std::string& path) {
+    // Only files with a resident texture are worth decoding; evicted
+    // entries load the new contents on their next request anyway
+    bool resident = false;
+    for (const auto& item : m_entries) {
+        if (item.second->path == path && item.second->texture) {
+            resident = true;
+            break;
+        }
+    }
+    if (!resident) {
+        return;
+    }
+
+    m_decoding.insert(path);
+    std::shared_ptr<ReloadQueue> queue = m_reloads;
+    const Uint32 nativeFormat = m_graphics.getNativeFormat();
+    ThreadPool::instance().enqueue([queue, path, nativeFormat]() {
+        ReloadQueue::Result result{ path, nullptr, std::string() };
+
+        // Same steps as Texture::create, minus the upload
+        try {
+            result.surface = Texture::decodeFile(path, nativeFormat);
+        } catch (const std::exception& e) {
+            result.error = e.what();
+        }
+
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        queue->ready.push_back(std::move(result));
+    });
+}
+
+void TextureManager::applyReload(ReloadQueue::Result& result) {
+    if (!result.surface) {
+        std::cout << "Hot reload of " << result.path << " failed: " << result.error << std::endl;
+        return;
+    }
+
+    // Every resident entry for this file gets its own copy of the pixels,
+    // then its load options applied again
+    std::vector<Entry*> targets;
+    for (const auto& item : m_entries) {
+        if (item.second->path == result.path && item.second->texture) {
+            targets.push_back(item.second.get());
+        }
+    }
+
+    for (size_t i = 0; i < targets.size(); ++i) {
+        Entry& entry = *targets[i];
+        SDL_Surface* surface = (i + 1 == targets.size()) ? result.surface : SDL_DuplicateSurface(result.surface);
+        if (!surface) {
+            continue;
+        }
+        try {
+            entry.texture->replacePixels(surface);
+            if (entry.options.width > 0 && entry.options.height > 0) {
+                entry.texture->resize(entry.options.width, entry.options.height, entry.options.scaleMode);
+            }
+        } catch (const std::exception& e) {
+            std::cout << "Hot reload of " << result.path << " failed: " << e.what() << std::endl;
+            continue;
+        }
+
+        m_stats.residentBytes -= entry.bytes;
+        entry.bytes = static_cast<size_t>(entry.texture->getWidth()) * entry.texture->getHeight() * 4;
+        m_stats.residentBytes += entry.bytes;
+        m_stats.hotReloads++;
+    }
+    if (targets.empty()) {
+        SDL_FreeSurface(result.surface);
+    }
+    result.surface = nullptr;
+}
@@ -0,0 +1,125 @@
+// texture_manager.hpp
+#pragma once
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "texture.hpp"
+
+class Graphics;
+class FileWatcher;
+class DecodedCache;
+
+// Loads textures from disk once and hands out shared references. Entries are
+// keyed by canonical path plus load options, so the same file requested
+// through different relative paths shares one GPU copy.
+//
+// A texture is in use while anyone outside the manager holds its shared_ptr.
+// When resident textures exceed the memory budget, unused ones are released
+// least recently requested first. Their entries are kept, so asking for the
+// same file again reloads it without the caller noticing.
+//
+// With hot reload on, files that change under a watched directory are
+// decoded on the thread pool and their pixels swapped into the existing
+// Texture objects by update(), so references held elsewhere stay valid.
+class TextureManager {
+public:
+    struct LoadOptions {
+        bool makeTarget = false;
+        int width = 0;          // Resize after loading when both are non-zero
+        int height = 0;
+        Texture::ScaleMode scaleMode = Texture::ScaleMode::Linear;
+    };
+
+    struct Stats {
+        int hits = 0;
+        int misses = 0;             // Includes reloads
+        int reloads = 0;            // Misses on entries that had been evicted
+        int evictions = 0;
+        int hotReloads = 0;         // Textures updated from changed files
+        size_t entries = 0;
+        size_t residentEntries = 0;
+        size_t residentBytes = 0;   // Estimated GPU memory of resident textures
+    };
+
+    // A budget of 0 means unlimited
+    explicit TextureManager(Graphics& graphics, size_t budgetBytes = 0);
+    ~TextureManager();
+
+    // Prevent copying
+    TextureManager(const TextureManager&) = delete;
+    TextureManager& operator=(const TextureManager&) = delete;
+
+    std::shared_ptr<Texture> loadTexture(const std::string& path);
+    std::shared_ptr<Texture> loadTexture(const std::string& path, const LoadOptions& options);
+
+    // Drops every entry nobody else references, resident or not
+    void releaseUnused();
+
+    // Changing the budget evicts immediately if needed
+    void setBudget(size_t budgetBytes);
+    size_t getBudget() const { return m_budget; }
+
+    // Loads through an on-disk cache of decoded pixels in directory from
+    // now on, skipping image decoding for files that haven't changed
+    void enableDecodedCache(const std::string& directory);
+
+    // Hot reload. Returns false if file watching isn't available on this
+    // platform or the directory can't be watched.
+    bool watchDirectory(const std::string& directory);
+
+    // Starts decoding changed files and applies finished ones. Call once a
+    // frame on the render thread.
+    void update();
+
+    const Stats& getStats() const { return m_stats; }
+
+private:
+    struct Entry {
+        std::string path;
+        LoadOptions options;
+        std::shared_ptr<Texture> texture;   // Null while evicted
+        size_t bytes = 0;
+        std::list<Entry*>::iterator lru;    // Valid while resident
+    };
+
+    // Decoded replacements, filled by pool tasks. Shared with the tasks so
+    // it outlives the manager if they are still running.
+    struct ReloadQueue {
+        struct Result {
+            std::string path;
+            SDL_Surface* surface;       // Null if decoding failed
+            std::string error;
+        };
+
+        std::mutex mutex;
+        std::vector<Result> ready;
+
+        ~ReloadQueue();
+    };
+
+    static std::string makeKey(const std::string& canonicalPath, const LoadOptions& options);
+    void load(Entry& entry);
+    void evict(Entry& entry);
+    void enforceBudget();
+    void startDecode(const std::string& path);
+    void applyReload(ReloadQueue::Result& result);
+
+    Graphics& m_graphics;
+    size_t m_budget;
+    std::unordered_map<std::string, std::unique_ptr<Entry>> m_entries;
+    std::list<Entry*> m_lru;            // Resident entries, most recently used first
+    Stats m_stats;
+
+    std::unique_ptr<DecodedCache> m_decodedCache;
+    std::unique_ptr<FileWatcher> m_watcher;
+    std::shared_ptr<ReloadQueue> m_reloads;
+    std::unordered_set<std::string> m_decoding;         // Paths with a decode in flight
+    std::unordered_set<std::string> m_changedAgain;     // Changed again while decoding
+    std::vector<std::string> m_changed;                 // Reused by update()
+    std::vector<ReloadQueue::Result> m_finished;        // Reused by update()
+};
@@ -0,0 +1,102 @@
+// thread_pool.cpp
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+ThreadPool::ThreadPool(unsigned threadCount) {
+    for (unsigned i = 0; i < threadCount; ++i) {
+        m_workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_condition.notify_all();
+    for (std::thread& worker : m_workers) {
+        worker.join();
+    }
+}
+
+ThreadPool& ThreadPool::instance() {
+    // Always at least one worker so enqueue() makes progress on one core
+    static ThreadPool pool(std::max(2u, std::thread::hardware_concurrency()) - 1);
+    return pool;
+}
+
+void ThreadPool::enqueue(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tasks.push(std::move(task));
+    }
+    m_condition.notify_one();
+}
+
+void ThreadPool::workerLoop() {
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this] { return m_stopping || !m_tasks.empty(); });
+            if (m_stopping && m_tasks.empty()) {
+                return;
+            }
+            task = std::move(m_tasks.front());
+            m_tasks.pop();
+        }
+        task();
+    }
+}
+
+void ThreadPool::parallelFor(int count, int minChunk, const std::function<void(int begin, int end)>& body) {
+    if (count <= 0) {
+        return;
+    }
+
+    const int participants = static_cast<int>(m_workers.size()) + 1;
+    const int chunkSize = std::max(std::max(1, minChunk), (count + participants * 4 - 1) / (participants * 4));
+    const int chunkCount = (count + chunkSize - 1) / chunkSize;
+
+    if (chunkCount == 1 || m_workers.empty()) {
+        body(0, count);
+        return;
+    }
+
+    // Helpers may still be waking up after the caller returns, so the shared
+    // state must outlive this call
+    struct State {
+        std::atomic<int> next{0};
+        std::atomic<int> finished{0};
+        std::mutex mutex;
+        std::condition_variable done;
+    };
+    auto state = std::make_shared<State>();
+    const std::function<void(int, int)>* bodyPtr = &body;
+
+    auto runChunks = [state, bodyPtr, count, chunkSize, chunkCount]() {
+        for (;;) {
+            int chunk = state->next.fetch_add(1);
+            if (chunk >= chunkCount) {
+                return;
+            }
+            int begin = chunk * chunkSize;
+            (*bodyPtr)(begin, std::min(count, begin + chunkSize));
+            if (state->finished.fetch_add(1) + 1 == chunkCount) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->done.notify_all();
+            }
+        }
+    };
+
+    const int helpers = std::min(chunkCount - 1, static_cast<int>(m_workers.size()));
+    for (int i = 0; i < helpers; ++i) {
+        enqueue(runChunks);
+    }
+    runChunks();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->done.wait(lock, [&] { return state->finished.load() == chunkCount; });
+}
@@ -0,0 +1,44 @@
+// thread_pool.hpp
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for CPU-side pixel work. Never call SDL
+// rendering functions from a pool task; the renderer belongs to the main
+// thread.
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned threadCount);
+    ~ThreadPool();
+
+    // Prevent copying
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Shared pool with one worker per hardware thread (minus the caller)
+    static ThreadPool& instance();
+
+    // Runs a task on a worker thread
+    void enqueue(std::function<void()> task);
+
+    // Splits [0, count) into chunks of at least minChunk items and runs them
+    // across the pool. The calling thread takes chunks too and the call
+    // returns once every chunk has finished, so it is safe to call from
+    // inside a pool task.
+    void parallelFor(int count, int minChunk, const std::function<void(int begin, int end)>& body);
+
+    unsigned getThreadCount() const { return static_cast<unsigned>(m_workers.size()); }
+
+private:
+    void workerLoop();
+
+    std::vector<std::thread> m_workers;
+    std::queue<std::function<void()>> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_stopping = false;
+};
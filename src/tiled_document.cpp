@@ -0,0 +1,387 @@
+// tiled_document.cpp
+#include "tiled_document.hpp"
+#include "texture.hpp"
+#include "qoi.hpp"
+#include "pixel_convert.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+const char kMagic[4] = { 'M', 'G', 'L', 'T' };
+const uint32_t kVersion = 1;
+
+// Rewrite the file once superseded tiles outweigh live ones by this much
+const uint64_t kCompactMinWaste = 1024 * 1024;
+
+// Integers are stored in the machine's byte order (little-endian on every
+// platform MuffinGL builds for)
+struct IndexSlot {
+    uint64_t generation;    // 0 for an unused slot
+    uint64_t offset;
+    uint64_t size;
+    uint64_t checksum;      // Covers the fields above and the index bytes
+};
+
+struct Header {
+    char magic[4];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t tileSize;
+    uint32_t reserved;
+    IndexSlot slots[2];
+};
+
+uint64_t slotChecksum(const IndexSlot& slot, const void* index) {
+    uint64_t hash = FileUtil::hash(&slot, offsetof(IndexSlot, checksum));
+    return FileUtil::hash(index, static_cast<size_t>(slot.size), hash);
+}
+
+bool isTransparent(const uint8_t* pixels, size_t count, Uint32 alphaMask) {
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t pixel;
+        std::memcpy(&pixel, pixels + i * 4, 4);
+        if (pixel & alphaMask) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+TiledDocument::TiledDocument(const std::string& path, int width, int height, int tileSize)
+    : m_path(path)
+    , m_width(width)
+    , m_height(height)
+    , m_tileSize(tileSize)
+    , m_tilesX((width + tileSize - 1) / tileSize)
+    , m_tilesY((height + tileSize - 1) / tileSize)
+{
+    m_tiles.assign(tileCount(), Tile{ 0, 0, 0 });
+    m_dirty.assign(tileCount(), 0);
+}
+
+TiledDocument TiledDocument::create(const std::string& path, int width, int height, int tileSize) {
+    if (width <= 0 || height <= 0 || tileSize <= 0) {
+        throw std::runtime_error("Invalid document size");
+    }
+    TiledDocument document(path, width, height, tileSize);
+    document.markAllDirty();
+    return document;
+}
+
+TiledDocument TiledDocument::open(const std::string& path) {
+    MappedFile file(path);
+    if (!file.isOpen() || file.size() < sizeof(Header)) {
+        throw std::runtime_error("Failed to open document: " + path);
+    }
+
+    Header header;
+    std::memcpy(&header, file.data(), sizeof(Header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion
+        || header.width == 0 || header.height == 0 || header.tileSize == 0) {
+        throw std::runtime_error("Not a MuffinGL document: " + path);
+    }
+
+    TiledDocument document(path, static_cast<int>(header.width), static_cast<int>(header.height),
+                           static_cast<int>(header.tileSize));
+    const uint64_t indexSize = static_cast<uint64_t>(document.tileCount()) * sizeof(Tile);
+
+    // Use the newest slot that is intact; the other one is the previous
+    // save, or a save that never finished
+    const IndexSlot* current = nullptr;
+    for (const IndexSlot& slot : header.slots) {
+        if (slot.generation == 0 || slot.size != indexSize
+            || slot.offset > file.size() || slot.size > file.size() - slot.offset) {
+            continue;
+        }
+        if (slotChecksum(slot, file.data() + slot.offset) != slot.checksum) {
+            continue;
+        }
+        if (!current || slot.generation > current->generation) {
+            current = &slot;
+        }
+    }
+    if (!current) {
+        throw std::runtime_error("Document has no intact tile index: " + path);
+    }
+
+    std::memcpy(document.m_tiles.data(), file.data() + current->offset, static_cast<size_t>(indexSize));
+    for (const Tile& tile : document.m_tiles) {
+        if (tile.offset != 0 && (tile.offset > file.size() || tile.size > file.size() - tile.offset)) {
+            throw std::runtime_error("Document tile index is corrupt: " + path);
+        }
+        document.m_stats.liveBytes += tile.size;
+    }
+
+    document.m_generation = current->generation;
+    document.m_fileSize = file.size();
+    document.m_stats.fileSize = file.size();
+    document.m_mapping = std::move(file);
+    return document;
+}
+
+SDL_Rect TiledDocument::tileRect(int index) const {
+    const int x = (index % m_tilesX) * m_tileSize;
+    const int y = (index / m_tilesX) * m_tileSize;
+    return SDL_Rect{ x, y, std::min(m_tileSize, m_width - x), std::min(m_tileSize, m_height - y) };
+}
+
+void TiledDocument::markDirty(const SDL_Rect& area) {
+    SDL_Rect bounds = { 0, 0, m_width, m_height };
+    SDL_Rect clipped;
+    if (!SDL_IntersectRect(&area, &bounds, &clipped)) {
+        return;
+    }
+    const int left = clipped.x / m_tileSize;
+    const int top = clipped.y / m_tileSize;
+    const int right = (clipped.x + clipped.w - 1) / m_tileSize;
+    const int bottom = (clipped.y + clipped.h - 1) / m_tileSize;
+    for (int ty = top; ty <= bottom; ++ty) {
+        for (int tx = left; tx <= right; ++tx) {
+            uint8_t& flag = m_dirty[ty * m_tilesX + tx];
+            if (!flag) {
+                flag = 1;
+                m_dirtyCount++;
+            }
+        }
+    }
+}
+
+void TiledDocument::markAllDirty() {
+    std::fill(m_dirty.begin(), m_dirty.end(), 1);
+    m_dirtyCount = tileCount();
+}
+
+bool TiledDocument::save(const Texture& canvas) {
+    if (canvas.getWidth() != m_width || canvas.getHeight() != m_height) {
+        throw std::runtime_error("Canvas and document must be the same size");
+    }
+
+    const uint64_t waste = m_fileSize - std::min(m_fileSize, m_stats.liveBytes + sizeof(Header));
+    const bool compact = m_fileSize == 0 || (waste > m_stats.liveBytes && waste > kCompactMinWaste);
+    if (!compact && m_dirtyCount == 0) {
+        m_stats.tilesWritten = 0;
+        m_stats.bytesWritten = 0;
+        return true;
+    }
+
+    Written written;
+    if (!compact) {
+        // Appending never touches bytes the current index uses
+        m_mapping.close();
+        if (!writeTiles(m_path, false, canvas, written)) {
+            return false;
+        }
+        commit(written);
+        return true;
+    }
+
+    // Write a fresh file beside the old one and swap it in. Clean tiles are
+    // copied from the old file, so only dirty ones are read back.
+    const bool replacing = m_fileSize > 0;
+    if (replacing && !m_mapping.isOpen()) {
+        m_mapping = MappedFile(m_path);
+    }
+    const std::string temporary = m_path + ".tmp";
+    const bool complete = writeTiles(temporary, true, canvas, written);
+    m_mapping.close();
+    if (!complete) {
+        std::error_code error;
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+
+    // The old file and index stay in use unless the new file replaces it
+    if (!FileUtil::replaceFile(temporary, m_path)) {
+        return false;
+    }
+    commit(written);
+    if (replacing) {
+        m_stats.compactions++;
+    }
+    return true;
+}
+
+bool TiledDocument::writeTiles(const std::string& filePath, bool fresh, const Texture& canvas,
+                               Written& written) {
+    std::fstream file;
+    uint64_t offset;
+    if (fresh) {
+        file.open(filePath, std::ios::binary | std::ios::out | std::ios::trunc);
+        Header header = {};
+        std::memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.version = kVersion;
+        header.width = static_cast<uint32_t>(m_width);
+        header.height = static_cast<uint32_t>(m_height);
+        header.tileSize = static_cast<uint32_t>(m_tileSize);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        offset = sizeof(header);
+    } else {
+        file.open(filePath, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(static_cast<std::streamoff>(m_fileSize));
+        offset = m_fileSize;
+    }
+    if (!file) {
+        return false;
+    }
+
+    const Uint32 format = canvas.getFormat();
+    int bpp;
+    Uint32 redMask, greenMask, blueMask, alphaMask;
+    SDL_PixelFormatEnumToMasks(format, &bpp, &redMask, &greenMask, &blueMask, &alphaMask);
+
+    std::vector<Tile> tiles = m_tiles;
+    std::vector<uint8_t> pixels(static_cast<size_t>(m_tileSize) * m_tileSize * 4);
+    std::ostringstream encoded;
+    int tilesWritten = 0;
+    size_t bytesWritten = 0;
+    uint64_t liveBytes = 0;
+
+    for (int i = 0; i < tileCount(); ++i) {
+        Tile& tile = tiles[i];
+        if (m_dirty[i]) {
+            const SDL_Rect rect = tileRect(i);
+            if (!canvas.readPixels(rect, pixels.data(), rect.w * 4)) {
+                return false;
+            }
+            if (isTransparent(pixels.data(), static_cast<size_t>(rect.w) * rect.h, alphaMask)) {
+                tile = Tile{ 0, 0, 0 };
+                continue;
+            }
+            if (canvas.isPremultiplied()) {
+                PixelConvert::unpremultiply(pixels.data(), rect.w * 4, format, rect.w, rect.h);
+            }
+
+            encoded.str(std::string());
+            Qoi::Encoder encoder(encoded, rect.w, rect.h);
+            encoder.writeRows(pixels.data(), rect.w * 4, format, rect.h);
+            encoder.finish();
+            const std::string& bytes = encoded.str();
+            file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+            tile = Tile{ offset, static_cast<uint32_t>(bytes.size()), 0 };
+            tilesWritten++;
+        } else if (fresh && tile.offset != 0) {
+            // Carry a clean tile over from the old file as is
+            file.write(reinterpret_cast<const char*>(m_mapping.data() + tile.offset), tile.size);
+            tile.offset = offset;
+        } else {
+            liveBytes += tile.size;
+            continue;
+        }
+        offset += tile.size;
+        bytesWritten += tile.size;
+        liveBytes += tile.size;
+    }
+
+    // The index goes after the tiles it points at
+    IndexSlot slot;
+    slot.generation = m_generation + 1;
+    slot.offset = offset;
+    slot.size = static_cast<uint64_t>(tiles.size()) * sizeof(Tile);
+    slot.checksum = slotChecksum(slot, tiles.data());
+    file.write(reinterpret_cast<const char*>(tiles.data()), static_cast<std::streamsize>(slot.size));
+    offset += slot.size;
+    bytesWritten += slot.size;
+
+    // Tiles and index must be on disk before the header points at them
+    file.flush();
+    if (!file) {
+        return false;
+    }
+    file.close();
+    if (!FileUtil::sync(filePath)) {
+        return false;
+    }
+
+    // Overwrite the older slot; the newer one stays valid until this lands
+    file.open(filePath, std::ios::binary | std::ios::in | std::ios::out);
+    file.seekp(static_cast<std::streamoff>(offsetof(Header, slots) + (slot.generation % 2) * sizeof(IndexSlot)));
+    file.write(reinterpret_cast<const char*>(&slot), sizeof(slot));
+    file.flush();
+    if (!file) {
+        return false;
+    }
+    file.close();
+    if (!FileUtil::sync(filePath)) {
+        return false;
+    }
+
+    written.tiles.swap(tiles);
+    written.generation = slot.generation;
+    written.fileSize = offset;
+    written.liveBytes = liveBytes;
+    written.tilesWritten = tilesWritten;
+    written.bytesWritten = bytesWritten;
+    return true;
+}
+
+void TiledDocument::commit(Written& written) {
+    m_tiles.swap(written.tiles);
+    std::fill(m_dirty.begin(), m_dirty.end(), 0);
+    m_dirtyCount = 0;
+    m_generation = written.generation;
+    m_fileSize = written.fileSize;
+    m_stats.tilesWritten = written.tilesWritten;
+    m_stats.bytesWritten = written.bytesWritten;
+    m_stats.fileSize = written.fileSize;
+    m_stats.liveBytes = written.liveBytes;
+}
+
+void TiledDocument::load(Texture& canvas, const SDL_Rect* area) {
+    if (canvas.getWidth() != m_width || canvas.getHeight() != m_height) {
+        throw std::runtime_error("Canvas and document must be the same size");
+    }
+    if (m_fileSize > 0 && !m_mapping.isOpen()) {
+        m_mapping = MappedFile(m_path);
+        if (!m_mapping.isOpen()) {
+            throw std::runtime_error("Failed to open document: " + m_path);
+        }
+    }
+
+    SDL_Rect bounds = { 0, 0, m_width, m_height };
+    SDL_Rect wanted = bounds;
+    if (area && !SDL_IntersectRect(area, &bounds, &wanted)) {
+        return;
+    }
+
+    const Uint32 format = canvas.getFormat();
+    std::vector<uint8_t> transparent;
+    m_stats.tilesDecoded = 0;
+
+    for (int i = 0; i < tileCount(); ++i) {
+        const SDL_Rect rect = tileRect(i);
+        if (!SDL_HasIntersection(&rect, &wanted)) {
+            continue;
+        }
+
+        const Tile& tile = m_tiles[i];
+        if (tile.offset == 0) {
+            transparent.resize(static_cast<size_t>(m_tileSize) * m_tileSize * 4, 0);
+            canvas.writePixels(rect, transparent.data(), rect.w * 4);
+            continue;
+        }
+
+        SDL_Surface* decoded = Qoi::decode(m_mapping.data() + tile.offset, tile.size, format);
+        if (!decoded) {
+            throw std::runtime_error("Failed to decode document tile: " + std::string(SDL_GetError()));
+        }
+        if (decoded->w != rect.w || decoded->h != rect.h) {
+            SDL_FreeSurface(decoded);
+            throw std::runtime_error("Document tile has the wrong size");
+        }
+        if (canvas.isPremultiplied()) {
+            PixelConvert::premultiply(decoded->pixels, decoded->pitch, format, rect.w, rect.h);
+        }
+        canvas.writePixels(rect, decoded->pixels, decoded->pitch);
+        SDL_FreeSurface(decoded);
+        m_stats.tilesDecoded++;
+    }
+}
@@ -0,0 +1,105 @@
+// tiled_document.hpp
+#pragma once
+#include <SDL2/SDL.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "file_util.hpp"
+
+class Texture;
+
+// Native canvas file. The image is split into square tiles, each compressed
+// on its own (QOI) and appended to the file. A tile index after the new
+// tiles says where the current version of every tile lives; fully
+// transparent tiles aren't stored at all. Tiles hold straight alpha even when
+// the canvas is premultiplied.
+//
+// Saving writes only the tiles marked dirty since the last save, then a new
+// index, then switches the header to it. The header holds two index slots
+// that are used alternately, each with a generation and checksum, so a save
+// interrupted at any point leaves the previous version readable. When more
+// than half the file is superseded tiles, the next save rewrites it compactly.
+//
+// Opening maps the file and reads only the header and index; tiles are
+// decoded when load() asks for them.
+class TiledDocument {
+public:
+    static const int DefaultTileSize = 256;
+
+    struct Stats {
+        int tilesWritten = 0;       // By the last save
+        size_t bytesWritten = 0;    // By the last save
+        int tilesDecoded = 0;       // By the last load
+        uint64_t fileSize = 0;
+        uint64_t liveBytes = 0;     // Bytes of tiles the current index uses
+        int compactions = 0;
+    };
+
+    // Starts a new document; nothing is written until the first save
+    static TiledDocument create(const std::string& path, int width, int height, int tileSize = DefaultTileSize);
+
+    // Opens an existing document. Throws if the file isn't a valid document.
+    static TiledDocument open(const std::string& path);
+
+    // Allow moving
+    TiledDocument(TiledDocument&&) = default;
+    TiledDocument& operator=(TiledDocument&&) = default;
+
+    int getWidth() const { return m_width; }
+    int getHeight() const { return m_height; }
+    int getTileSize() const { return m_tileSize; }
+
+    // Tiles overlapping area will be written by the next save
+    void markDirty(const SDL_Rect& area);
+    void markAllDirty();
+    bool isDirty() const { return m_dirtyCount > 0; }
+
+    // Writes the dirty tiles of canvas, which must be the document's size.
+    // Returns false if writing failed; the tiles stay dirty in that case.
+    bool save(const Texture& canvas);
+
+    // Uploads the tiles overlapping area (everything by default) into canvas
+    void load(Texture& canvas, const SDL_Rect* area = nullptr);
+
+    const Stats& getStats() const { return m_stats; }
+
+private:
+    struct Tile {
+        uint64_t offset;    // 0 for a transparent tile
+        uint32_t size;
+        uint32_t reserved;
+    };
+
+    // What a successful writeTiles() leaves on disk; becomes the
+    // document's state only once that file is the one at m_path
+    struct Written {
+        std::vector<Tile> tiles;
+        uint64_t generation = 0;
+        uint64_t fileSize = 0;
+        uint64_t liveBytes = 0;
+        int tilesWritten = 0;
+        size_t bytesWritten = 0;
+    };
+
+    TiledDocument(const std::string& path, int width, int height, int tileSize);
+
+    int tileCount() const { return m_tilesX * m_tilesY; }
+    SDL_Rect tileRect(int index) const;
+    bool writeTiles(const std::string& filePath, bool fresh, const Texture& canvas, Written& written);
+    void commit(Written& written);
+
+    std::string m_path;
+    int m_width;
+    int m_height;
+    int m_tileSize;
+    int m_tilesX;
+    int m_tilesY;
+
+    std::vector<Tile> m_tiles;
+    std::vector<uint8_t> m_dirty;       // One flag per tile
+    int m_dirtyCount = 0;
+    uint64_t m_generation = 0;          // Generation of the index in use
+    uint64_t m_fileSize = 0;            // 0 until the file exists
+    MappedFile m_mapping;               // Opened on demand by load()
+    Stats m_stats;
+};